@@ -3,12 +3,14 @@
  * Author: Naga Kandasamy
  * Date created: February 24, 2020
  * 
- * Compile as follows: gcc -o counting_sort counting_sort.c -std=c99 -Wall -O3 -lpthread -lm
+ * Compile as follows: gcc -o counting_sort counting_sort.c histogram.c -std=c99 -Wall -O3 -lpthread -lm
  * 
  * Edited by: Daniel Rodriguez, Zoe Sucato
  * 
  */
 
+#define _GNU_SOURCE     /* pthread_barrier_t is hidden by -std=c99 otherwise */
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
@@ -18,6 +20,7 @@
 #include <limits.h>
 #include <pthread.h>
 #include <sys/time.h>
+#include "histogram.h"
 
 /* Do not change the range value. */
 #define MIN_VALUE 0 
@@ -34,7 +37,9 @@ typedef struct args_for_thread_t {
     int *input_array;
     int num_elements;                              /* Number of elements*/
     int *bin;                           /* Location of the shared variable bin array */
-    pthread_mutex_t *mutex_for_bin;     /* Location of the lock variable protecting bin array */
+    int *sorted_array;                  /* Each thread writes an equal share of it */
+    int **sub_bin;                      /* Private histogram of each thread, merged into bin */
+    pthread_barrier_t *barrier;         /* Between counting and merging */
 } ARGS_FOR_THREAD;
 
 struct timeval start, stop;	
@@ -203,21 +208,12 @@ compute_using_pthreads (int *input_array, int *sorted_array, int num_elements, i
     }
 
     pthread_attr_t attributes;                  /* Thread attributes */
-    // pthread_mutex_t mutex_for_bin;
-    
     pthread_attr_init (&attributes);            /* Initialize the thread attributes to the default values */
-    // pthread_mutex_init(&mutex_for_bin,NULL);
 
-
-    // allocate mem for array of mutex the size of the number of bins.
-    pthread_mutex_t *mutex_for_bin = (pthread_mutex_t *) malloc (sizeof (pthread_mutex_t) * num_bins);
-    if (mutex_for_bin == NULL) {
-        perror ("malloc");
-        exit (EXIT_FAILURE);
-    }
-    // initialize each element of mutex array. 
-    for(int i = 0; i < num_bins; i++)
-        pthread_mutex_init (&mutex_for_bin[i], NULL);  /* Initialize the mutex */
+    /* one private histogram per thread instead of a lock per bin */
+    int **sub_bin = histogram_alloc (num_threads, num_bins);
+    pthread_barrier_t barrier;
+    pthread_barrier_init (&barrier, NULL, num_threads);
 
     /* Allocate memory on the heap for the required data structures and create the worker threads */
     int i;
@@ -231,7 +227,9 @@ compute_using_pthreads (int *input_array, int *sorted_array, int num_elements, i
         args_for_thread[i]->range = range; 
         args_for_thread[i]->input_array = input_array;
         args_for_thread[i]->bin = bin;
-        args_for_thread[i]->mutex_for_bin = mutex_for_bin;
+        args_for_thread[i]->sorted_array = sorted_array;
+        args_for_thread[i]->sub_bin = sub_bin;
+        args_for_thread[i]->barrier = &barrier;
     }
 
 
@@ -241,25 +239,16 @@ compute_using_pthreads (int *input_array, int *sorted_array, int num_elements, i
     }
 
 
-    /* Wait for the workers to finish */
+    /* Wait for the workers to finish, they generate the sorted array too */
     for(i = 0; i < num_threads; i++)
         pthread_join (tid[i], NULL);
-
-
-    /* Generate the sorted array. */
-    int j;
-    int idx = 0;
-    
-    for (i = 0; i < num_bins; i++) {
-        for (j = 0; j < bin[i]; j++) {
-            sorted_array[idx++] = i;
-        }
-    }
     gettimeofday (&stop, NULL);
 		
     /* Free data structures */
     for(i = 0; i < num_threads; i++)
         free ((void *) args_for_thread[i]);
+    pthread_barrier_destroy (&barrier);
+    histogram_free (sub_bin, num_threads);
 
 
 }
@@ -275,37 +264,21 @@ thread_arr (void *args)
 
 
     int num_bins =args_for_me->range + 1;
-    int *part_bin = (int *) malloc (num_bins * sizeof (int));    
-    if (part_bin == NULL) {
-        perror ("Malloc");
-        return 0;
-    }
-
-    int i;
-    memset(part_bin, 0, num_bins); /* Initialize histogram bins to zero */ 
-    // for (i = args_for_me->tid; i < args_for_me->num_elements; i+= args_for_me->num_threads)
-    //     part_bin[args_for_me->input_array[i]]++;
-    int step = args_for_me->num_elements / args_for_me->num_threads;
     int tid = args_for_me->tid;
-    
-    if (tid != args_for_me->num_threads-1){// makes sure tid is not last thread
-        for (i = tid*step; i < step*(tid+1); i++){
-            part_bin[args_for_me->input_array[i]]++;
-        }
-    } else {
-        for (i = tid*step; i < args_for_me->num_elements; i++){
-            part_bin[args_for_me->input_array[i]]++;
-        }
-    }
+    int start, end;
 
+    histogram_block (args_for_me->num_elements, tid, args_for_me->num_threads, &start, &end);
+    histogram_count (args_for_me->input_array, start, end, args_for_me->sub_bin[tid], num_bins);
 
-    // pthread_mutex_lock(args_for_me->mutex_for_bin);
-    for(i = 0; i < num_bins; i++){
-        pthread_mutex_lock(&args_for_me->mutex_for_bin[i]);
-        args_for_me->bin[i] += part_bin[i];
-        pthread_mutex_unlock(&args_for_me->mutex_for_bin[i]);
-    }
-    // pthread_mutex_unlock(args_for_me->mutex_for_bin);
+    /* once every thread has counted, each one sums its slice of the bins */
+    pthread_barrier_wait (args_for_me->barrier);
+    histogram_merge (args_for_me->sub_bin, args_for_me->num_threads, args_for_me->bin, num_bins,
+                     tid, args_for_me->num_threads);
+
+    /* Generate the sorted array: once all bins are merged, each thread writes an equal share */
+    pthread_barrier_wait (args_for_me->barrier);
+    histogram_fill (args_for_me->bin, num_bins, args_for_me->sorted_array, args_for_me->num_elements,
+                    tid, args_for_me->num_threads);
     
     
     pthread_exit ((void *)0);
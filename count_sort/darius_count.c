@@ -3,7 +3,13 @@
  * 
  * Date modified: March 26, 2020
  *
- * Compile as follows: gcc -o counting_sort counting_sort.c -std=c99 -Wall -O3 -lpthread -lm
+ * Compile as follows: gcc -o darius_count darius_count.c -std=c99 -Wall -O3 -lpthread -lm
+ *
+ * The input is uniform over the range, or with "zipf" Zipf distributed:
+ * the k-th value is drawn with probability proportional to 1/k^exponent,
+ * so a few hot values hold most of the elements. The fill of the sorted
+ * array is split by output position, not by bin, so it stays balanced
+ * over the threads either way.
  */
 
 #include <stdlib.h>
@@ -20,12 +26,15 @@
 #define MIN_VALUE 0 
 #define MAX_VALUE 1023
 
+#define ZIPF_EXPONENT 1.2       /* Default exponent of the zipf input */
+
 /* Comment out if you don't need debug info */
 // #define DEBUG
 // #define DEBUG_MORE_VERBOSE
 
 int compute_gold (int *, int *, int, int);
 int rand_int (int, int);
+void generate_zipf (int *, int, int, int, double);
 void print_array (int *, int);
 void print_min_and_max_in_array (int *, int);
 void compute_using_pthreads (int *, int *, int, int, int);
@@ -49,33 +58,45 @@ int * bin_multi;
 int * bin_sums_multi;
 int * sorted_array_d;
 pthread_mutex_t mutex[1024];
+double fill_time;               /* Time the threads spent writing the sorted array */
 
 int 
 main (int argc, char **argv)
 {
     /* Check argument input */
-    if (argc != 3) {
-        printf ("Usage: %s num-elements num-threads\n", argv[0]);
+    if (argc < 3 || argc > 5 || (argc > 3 && strcmp (argv[3], "uniform") != 0 && strcmp (argv[3], "zipf") != 0)) {
+        printf ("Usage: %s num-elements num-threads [uniform | zipf [exponent]]\n", argv[0]);
+        printf ("zipf: value k is drawn with probability proportional to 1/(k+1)^exponent (default %.1f)\n", ZIPF_EXPONENT);
         exit (EXIT_FAILURE);
     }
 
     /* Parse command-line arguments. */
     int num_elements = atoi (argv[1]);
     int num_threads = atoi (argv[2]);
+    int zipf = (argc > 3 && strcmp (argv[3], "zipf") == 0);
+    double exponent = (argc > 4) ? atof (argv[4]) : ZIPF_EXPONENT;
 
     int range = MAX_VALUE - MIN_VALUE;
     int *input_array, *sorted_array_reference;
 
     /* Populate the input array with random integers between [0, RANGE]. */
-    printf ("Generating input array with %d elements in the range 0 to %d\n", num_elements, range);
+    if (zipf)
+        printf ("Generating input array with %d Zipf distributed elements in the range 0 to %d, exponent %f\n",
+                num_elements, range, exponent);
+    else
+        printf ("Generating input array with %d elements in the range 0 to %d\n", num_elements, range);
     input_array = (int *) malloc (num_elements * sizeof (int));
     if (input_array == NULL) {
         printf ("Cannot malloc memory for the input array. \n");
         exit (EXIT_FAILURE);
     }
     srand (time (NULL));
-    for (int i = 0; i < num_elements; i++)
-        input_array[i] = rand_int (MIN_VALUE, MAX_VALUE);
+    if (zipf) {
+        generate_zipf (input_array, num_elements, MIN_VALUE, MAX_VALUE, exponent);
+    } else {
+        for (int i = 0; i < num_elements; i++)
+            input_array[i] = rand_int (MIN_VALUE, MAX_VALUE);
+    }
 
 #ifdef DEBUG
     print_array (input_array, num_elements);
@@ -130,6 +151,19 @@ main (int argc, char **argv)
     gettimeofday (&stop, NULL); /* End timer */
     time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
     printf ("Time to use %d threads version: %fs\n",num_threads, time_taken);
+    printf ("Time to fill the sorted array: %fs\n", fill_time);
+
+    /* How evenly the fill was shared, against handing out whole bins cyclically */
+    int largest_cyclic = 0;
+    for (int t = 0; t < num_threads; t++) {
+        int share = 0;
+        for (int b = t; b < range + 1; b += num_threads)
+            share += bin_multi[b];
+        if (share > largest_cyclic)
+            largest_cyclic = share;
+    }
+    printf ("Largest fill share: %d elements, %d if whole bins were dealt out cyclically\n",
+            (num_elements + num_threads - 1) / num_threads, largest_cyclic);
 
     /* Check the two results for correctness. */
     printf ("\nComparing reference and pthread results\n");
@@ -157,7 +191,7 @@ compute_gold (int *input_array, int *sorted_array, int num_elements, int range)
         return 0;
     }
 
-    memset(bin, 0, num_bins); /* Initialize histogram bins to zero */ 
+    memset(bin, 0, num_bins * sizeof (int)); /* Initialize histogram bins to zero */ 
     for (i = 0; i < num_elements; i++)
         bin[input_array[i]]++;
 
@@ -191,7 +225,7 @@ compute_using_pthreads (int *input_array, int *sorted_array, int num_elements, i
 
     pthread_t *worker_thread = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
     ARGS_FOR_THREAD *args_for_thread;
-    bin_multi = malloc((range +1) * sizeof(int));
+    bin_multi = calloc(range +1, sizeof(int));
     bin_sums_multi = malloc((range +1) * sizeof(int));
     int i;
 
@@ -227,11 +261,14 @@ compute_using_pthreads (int *input_array, int *sorted_array, int num_elements, i
     }
 
     /* Multi-thread the sorting of the newly created global histogram */
+    struct timeval start, stop;
+    gettimeofday (&start, NULL);
     for (i = 0; i < num_threads; i++) {
         /* fill argument struct */
         args_for_thread = (ARGS_FOR_THREAD *) malloc (sizeof (ARGS_FOR_THREAD)); /* Memory for structure to pack the arguments */
         args_for_thread->num_threads = num_threads;
         args_for_thread->input_array = input_array;
+        args_for_thread->num_elements = num_elements;
         args_for_thread->range = range;
         args_for_thread->pid = i; 
 
@@ -245,6 +282,8 @@ compute_using_pthreads (int *input_array, int *sorted_array, int num_elements, i
     for (i = 0; i < num_threads; i++){
         pthread_join (worker_thread[i], NULL);
     }
+    gettimeofday (&stop, NULL);
+    fill_time = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000);
     free ((void *) worker_thread);
 
     return;
@@ -253,7 +292,11 @@ compute_using_pthreads (int *input_array, int *sorted_array, int num_elements, i
 /*------------------------------------------------------------------
  * Function:    sort_pthreads
  * Purpose:     This function sorts the global histogram in a multi-threaded
- *              fashion
+ *              fashion. Every thread writes an equal share of the sorted
+ *              array, positions num_elements * pid / num_threads up to the
+ *              share of the next thread, starting in whichever bin holds
+ *              its first position, so a bin with many elements is split
+ *              over several threads
  *                   
  * Input args:  this_arg (thread argument structure)
  * Return val:  none
@@ -262,10 +305,27 @@ void
 sort_pthreads(void *this_arg)
 {
     ARGS_FOR_THREAD *args_for_me = (ARGS_FOR_THREAD *) this_arg;
-    int i,j;
-    for (i = args_for_me->pid ; i < args_for_me->range +1; i+=args_for_me->num_threads) {
-        for (j = 0; j < bin_multi[i]; j++) {
-            sorted_array_d[bin_sums_multi[i]+j] = i;
+    int num_bins = args_for_me->range + 1;
+    int first = (int) ((long) args_for_me->num_elements * args_for_me->pid / args_for_me->num_threads);
+    int last = (int) ((long) args_for_me->num_elements * (args_for_me->pid + 1) / args_for_me->num_threads);
+    int i, b;
+
+    /* last bin that starts at or before first in the cumulative histogram, the one holding first */
+    int low = 0, high = num_bins - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (bin_sums_multi[mid] <= first)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+
+    for (i = first, b = low; i < last; b++) {
+        int end = bin_sums_multi[b] + bin_multi[b];
+        if (end > last)
+            end = last;
+        for (; i < end; i++) {
+            sorted_array_d[i] = b;
         }
     }
 }
@@ -295,7 +355,7 @@ compute_gold_pthreads(void *this_arg)
         return;
     }
 
-    memset(bin, 0, num_bins); /* Initialize histogram bins to zero */
+    memset(bin, 0, num_bins * sizeof (int)); /* Initialize histogram bins to zero */
     int step = num_elements / num_threads;
     /* split the array into chunks and make a histogram for each one */
     if (pid < num_threads-1){
@@ -355,6 +415,48 @@ rand_int (int min, int max)
     return (int) floorf (min + (max - min) * r);
 }
 
+/*------------------------------------------------------------------
+ * Function:    generate_zipf
+ * Purpose:     Fill array with num_elements integers in [min, max], value
+ *              min + k drawn with probability proportional to
+ *              1/(k+1)^exponent
+ *
+ * Input args:  num_elements, min, max, exponent
+ * Output args: array
+ * Return val:  none
+ */  /*  */
+void
+generate_zipf (int *array, int num_elements, int min, int max, double exponent)
+{
+    int num_values = max - min + 1;
+    double *cdf = (double *) malloc (num_values * sizeof (double));
+    if (cdf == NULL) {
+        perror ("Malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    double sum = 0.0;
+    for (int k = 0; k < num_values; k++) {
+        sum += 1.0 / pow (k + 1, exponent);
+        cdf[k] = sum;
+    }
+
+    for (int i = 0; i < num_elements; i++) {
+        double r = sum * rand () / ((double) RAND_MAX + 1.0);
+        /* first value whose cumulative weight exceeds r */
+        int low = 0, high = num_values - 1;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (cdf[mid] > r)
+                high = mid;
+            else
+                low = mid + 1;
+        }
+        array[i] = min + low;
+    }
+    free ((void *) cdf);
+}
+
 /* Helper function to print the given array. */
 void
 print_array (int *this_array, int num_elements)
@@ -0,0 +1,316 @@
+/* Privatized histograms of int keys, without locks.
+ *
+ * Each thread counts its part of the keys into a sub-histogram of its own,
+ * allocated by histogram_alloc on a cache line boundary so no two threads
+ * ever write the same line. The sub-histograms are then merged in
+ * parallel: after a barrier, thread tid sums bins of its own slice over
+ * all sub-histograms with histogram_merge. The slices are whole cache lines
+ * of the result, so the merge needs no locks either and every thread reads
+ * num_bins / num_threads bins of each sub-histogram. This replaces a merge
+ * that locked one mutex per bin, num_bins lock and unlock pairs per thread.
+ *
+ * histogram_count spreads the keys over HISTOGRAM_LANES interleaved
+ * counter arrays, key i going to lane i % HISTOGRAM_LANES. With a single
+ * array a run of equal keys makes every increment wait for the store of
+ * the one before it; with four the consecutive increments of a run hit
+ * different counters and overlap.
+ *
+ * histogram_fill writes the sorted keys a histogram stands for. The output
+ * is split evenly by index, not by bin, so every thread writes
+ * num_elements / num_threads keys whatever the distribution of the keys;
+ * a thread finds the bin its part starts in from the running exclusive
+ * prefix sum of the bins. Parts of HISTOGRAM_STREAM_MIN keys or more are
+ * written with non-temporal SSE2 stores, which go to memory without first
+ * reading each line into the cache and without pushing the input out.
+ *
+ * compute_histogram_pthreads puts counting and merging together for
+ * callers that do not have threads of their own.
+ *
+ * The sorts that move records instead of rebuilding them from the merged
+ * histogram keep the sub-histograms apart: histogram_offsets turns them
+ * into the first output position of every (bin, sub-histogram) pair, so
+ * each thread can scatter its block of histogram_block stably.
+ *
+ * Compiled together with counting_sort.c, matt_sort.c, radix_sort.c,
+ * kv_sort.c and histogram_bench.c, see the compile lines there.
+ */
+
+#define _GNU_SOURCE     /* pthread_barrier_t is hidden by -std=c99 otherwise */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "histogram.h"
+
+/* Structure used to pass arguments to the threads of compute_histogram_pthreads */
+typedef struct histogram_args_s {
+    int tid;                            /* The thread ID */
+    int num_threads;
+    const int *keys;
+    int num_elements;
+    int *bin;                           /* Merged histogram */
+    int num_bins;
+    int **sub_bin;                      /* Private histogram of each thread */
+    pthread_barrier_t *barrier;
+} HISTOGRAM_ARGS;
+
+void* histogram_pthreads (void *);
+
+/*------------------------------------------------------------------
+ * Function:    histogram_alloc
+ * Purpose:     Allocate num_sub zeroed sub-histograms of num_bins bins, each
+ *              starting on its own cache line
+ *
+ * Input args:  num_sub, num_bins
+ * Return val:  the sub-histograms
+ */  /*  */
+int **
+histogram_alloc (int num_sub, int num_bins)
+{
+    int **sub_bin = (int **) malloc (num_sub * sizeof (int *));
+    if (sub_bin == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    for (int s = 0; s < num_sub; s++) {
+        if (posix_memalign ((void **) &sub_bin[s], HISTOGRAM_ALIGN, num_bins * sizeof (int)) != 0) {
+            perror ("posix_memalign");
+            exit (EXIT_FAILURE);
+        }
+        memset (sub_bin[s], 0, num_bins * sizeof (int));
+    }
+    return sub_bin;
+}
+
+/* Free what histogram_alloc allocated. */
+void
+histogram_free (int **sub_bin, int num_sub)
+{
+    for (int s = 0; s < num_sub; s++)
+        free ((void *) sub_bin[s]);
+    free ((void *) sub_bin);
+}
+
+/* Set [*start, *end) to the contiguous block of num_elements that thread tid of num_threads handles, the last thread taking the remainder. */
+void
+histogram_block (int num_elements, int tid, int num_threads, int *start, int *end)
+{
+    int step = num_elements / num_threads;
+    *start = tid * step;
+    *end = (tid == num_threads - 1) ? num_elements : *start + step;
+}
+
+/*------------------------------------------------------------------
+ * Function:    histogram_count
+ * Purpose:     Count keys[start .. end-1], each in [0, num_bins), into
+ *              sub_bin, overwriting it
+ *
+ * Input args:  keys, start, end, num_bins
+ * Output args: sub_bin
+ * Return val:  none
+ */  /*  */
+void
+histogram_count (const int *keys, int start, int end, int *sub_bin, int num_bins)
+{
+    int *lane = (int *) calloc (HISTOGRAM_LANES * num_bins, sizeof (int));
+    int i, l, b;
+
+    if (lane == NULL) {
+        perror ("calloc");
+        exit (EXIT_FAILURE);
+    }
+
+    for (i = start; i + HISTOGRAM_LANES <= end; i += HISTOGRAM_LANES)
+        for (l = 0; l < HISTOGRAM_LANES; l++)
+            lane[l * num_bins + keys[i + l]]++;
+    for (; i < end; i++)
+        lane[keys[i]]++;
+
+    for (b = 0; b < num_bins; b++) {
+        int count = 0;
+        for (l = 0; l < HISTOGRAM_LANES; l++)
+            count += lane[l * num_bins + b];
+        sub_bin[b] = count;
+    }
+    free ((void *) lane);
+}
+
+/*------------------------------------------------------------------
+ * Function:    histogram_merge
+ * Purpose:     Thread tid of num_threads sets its slice of bin to the sum
+ *              of the num_sub sub-histograms. Once all threads have called
+ *              it, bin holds the whole sum
+ *
+ * Input args:  sub_bin, num_sub, num_bins, tid, num_threads
+ * Output args: bin
+ * Return val:  none
+ */  /*  */
+void
+histogram_merge (int **sub_bin, int num_sub, int *bin, int num_bins, int tid, int num_threads)
+{
+    int bins_per_line = HISTOGRAM_ALIGN / sizeof (int);
+    int num_lines = (num_bins + bins_per_line - 1) / bins_per_line;
+    int first = (int) ((long) num_lines * tid / num_threads) * bins_per_line;
+    int last = (int) ((long) num_lines * (tid + 1) / num_threads) * bins_per_line;
+    int s, b;
+
+    if (last > num_bins)
+        last = num_bins;
+    for (b = first; b < last; b++)
+        bin[b] = sub_bin[0][b];
+    for (s = 1; s < num_sub; s++)
+        for (b = first; b < last; b++)
+            bin[b] += sub_bin[s][b];
+}
+
+/*------------------------------------------------------------------
+ * Function:    histogram_offsets
+ * Purpose:     Turn the counts of num_sub sub-histograms into output
+ *              positions, the exclusive prefix sum over (bin, sub-histogram):
+ *              sub_bin[s][b] becomes the number of keys in bins below b plus
+ *              those in bin b of sub-histograms below s. Run by one thread
+ *              once all sub-histograms are counted
+ *
+ * Input args:  sub_bin, num_sub, num_bins
+ * Output args: sub_bin
+ * Return val:  none
+ */  /*  */
+void
+histogram_offsets (int **sub_bin, int num_sub, int num_bins)
+{
+    int sum = 0;
+    for (int b = 0; b < num_bins; b++) {
+        for (int s = 0; s < num_sub; s++) {
+            int count = sub_bin[s][b];
+            sub_bin[s][b] = sum;
+            sum += count;
+        }
+    }
+}
+
+/* Set out[start .. end-1] to value, with non-temporal stores if stream is set. */
+static void
+fill_run (int *out, int start, int end, int value, int stream)
+{
+#if defined(__SSE2__)
+    if (stream) {
+        __m128i v = _mm_set1_epi32 (value);
+        for (; start < end && ((uintptr_t) &out[start] & 15) != 0; start++)
+            out[start] = value;
+        for (; start + 4 <= end; start += 4)
+            _mm_stream_si128 ((__m128i *) &out[start], v);
+    }
+#endif
+    for (; start < end; start++)
+        out[start] = value;
+}
+
+/*------------------------------------------------------------------
+ * Function:    histogram_fill
+ * Purpose:     Thread tid of num_threads writes its share of the sorted
+ *              keys bin stands for: output indices num_elements * tid /
+ *              num_threads up to the share of thread tid + 1, where the
+ *              keys of bin b are b. Once all threads have called it
+ *              sorted_array holds all num_elements keys
+ *
+ * Input args:  bin, num_bins, num_elements, tid, num_threads
+ * Output args: sorted_array
+ * Return val:  none
+ */  /*  */
+void
+histogram_fill (const int *bin, int num_bins, int *sorted_array, int num_elements, int tid, int num_threads)
+{
+    int first = (int) ((long) num_elements * tid / num_threads);
+    int last = (int) ((long) num_elements * (tid + 1) / num_threads);
+    int stream = (last - first >= HISTOGRAM_STREAM_MIN);
+    int b = 0, bin_start = 0;
+
+    /* find the bin output index first falls in from the exclusive prefix sum */
+    while (b < num_bins && bin_start + bin[b] <= first) {
+        bin_start += bin[b];
+        b++;
+    }
+    for (int i = first; i < last; b++) {
+        int end = bin_start + bin[b];
+        if (end > last)
+            end = last;
+        fill_run (sorted_array, i, end, b, stream);
+        i = end;
+        bin_start += bin[b];
+    }
+#if defined(__SSE2__)
+    /* make the streamed keys visible before the caller's next barrier or join */
+    if (stream)
+        _mm_sfence ();
+#endif
+}
+
+/*------------------------------------------------------------------
+ * Function:    compute_histogram_pthreads
+ * Purpose:     Histogram of num_elements keys in [0, num_bins) with
+ *              num_threads threads, each counting a contiguous block and
+ *              merging a slice of the bins
+ *
+ * Input args:  keys, num_elements, num_bins, num_threads
+ * Output args: bin
+ * Return val:  none
+ */  /*  */
+void
+compute_histogram_pthreads (const int *keys, int num_elements, int *bin, int num_bins, int num_threads)
+{
+    pthread_t *tid = (pthread_t *) malloc (sizeof (pthread_t) * num_threads);
+    HISTOGRAM_ARGS *args_for_thread = (HISTOGRAM_ARGS *) malloc (sizeof (HISTOGRAM_ARGS) * num_threads);
+    int **sub_bin = histogram_alloc (num_threads, num_bins);
+    pthread_barrier_t barrier;
+    int i;
+
+    if (tid == NULL || args_for_thread == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    pthread_barrier_init (&barrier, NULL, num_threads);
+
+    for (i = 0; i < num_threads; i++) {
+        args_for_thread[i].tid = i;
+        args_for_thread[i].num_threads = num_threads;
+        args_for_thread[i].keys = keys;
+        args_for_thread[i].num_elements = num_elements;
+        args_for_thread[i].bin = bin;
+        args_for_thread[i].num_bins = num_bins;
+        args_for_thread[i].sub_bin = sub_bin;
+        args_for_thread[i].barrier = &barrier;
+
+        if ((pthread_create (&tid[i], NULL, histogram_pthreads, (void *) &args_for_thread[i])) != 0) {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < num_threads; i++)
+        pthread_join (tid[i], NULL);
+
+    pthread_barrier_destroy (&barrier);
+    histogram_free (sub_bin, num_threads);
+    free ((void *) args_for_thread);
+    free ((void *) tid);
+}
+
+/* Body of a compute_histogram_pthreads thread: count the block, wait for the others, merge the slice. */
+void *
+histogram_pthreads (void *args)
+{
+    HISTOGRAM_ARGS *args_for_me = (HISTOGRAM_ARGS *) args;
+    int tid = args_for_me->tid;
+    int num_threads = args_for_me->num_threads;
+    int start, end;
+
+    histogram_block (args_for_me->num_elements, tid, num_threads, &start, &end);
+    histogram_count (args_for_me->keys, start, end, args_for_me->sub_bin[tid], args_for_me->num_bins);
+    pthread_barrier_wait (args_for_me->barrier);
+    histogram_merge (args_for_me->sub_bin, num_threads, args_for_me->bin, args_for_me->num_bins, tid, num_threads);
+    return NULL;
+}
@@ -0,0 +1,18 @@
+#ifndef __HISTOGRAM__
+#define __HISTOGRAM__
+
+#define HISTOGRAM_ALIGN 64      /* Sub-histograms and merge slices start on a cache line */
+#define HISTOGRAM_LANES 4       /* Interleaved counters per bin in histogram_count */
+#define HISTOGRAM_STREAM_MIN (1 << 18)  /* Outputs per thread from which histogram_fill bypasses the cache */
+
+/* histogram.c */
+int **histogram_alloc (int, int);
+void histogram_free (int **, int);
+void histogram_block (int, int, int, int *, int *);
+void histogram_count (const int *, int, int, int *, int);
+void histogram_merge (int **, int, int *, int, int, int);
+void histogram_offsets (int **, int, int);
+void histogram_fill (const int *, int, int *, int, int, int);
+void compute_histogram_pthreads (const int *, int, int *, int, int);
+
+#endif
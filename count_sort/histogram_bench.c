@@ -0,0 +1,213 @@
+/* Micro-benchmark of the histogram kernel in histogram.c
+ *
+ * Date created: October 17, 2026
+ *
+ * Compile as follows: gcc -o histogram_bench histogram_bench.c histogram.c -std=c99 -Wall -O3 -lpthread -lm
+ *
+ * Times four ways of computing the histogram of the same keys, on keys
+ * drawn uniformly from the bins and on keys that are all the same, the
+ * case where a single counter array stalls on every increment:
+ *
+ *  - serial:       one thread, one counter per bin
+ *  - interleaved:  one thread, histogram_count
+ *  - mutex merge:  private histograms merged under one mutex per bin, as
+ *                  counting_sort.c and matt_sort.c used to do
+ *  - privatized:   compute_histogram_pthreads
+ *
+ * Every run is repeated NUM_RUNS times and the fastest is reported, with
+ * its rate in keys per second. Each result is checked against the serial
+ * one.
+ */
+
+#define _GNU_SOURCE     /* pthread_barrier_t is hidden by -std=c99 otherwise */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "histogram.h"
+
+#define NUM_BINS 1024           /* Default number of bins, the range of counting_sort.c */
+#define NUM_RUNS 5
+
+/* Structure used to pass arguments to the threads of the mutex merge */
+typedef struct args_for_thread_t {
+    int tid;
+    int num_threads;
+    const int *keys;
+    int num_elements;
+    int *bin;
+    int num_bins;
+    pthread_mutex_t *mutex_for_bin;
+} ARGS_FOR_THREAD;
+
+/* The histogram methods, all with the signature of compute_histogram_pthreads */
+typedef void (*HISTOGRAM_FN) (const int *, int, int *, int, int);
+
+void histogram_serial (const int *, int, int *, int, int);
+void histogram_interleaved (const int *, int, int *, int, int);
+void histogram_mutex_merge (const int *, int, int *, int, int);
+void* mutex_merge_pthreads (void *);
+void time_histogram (const char *, HISTOGRAM_FN, const int *, int, int, int, const int *);
+
+int
+main (int argc, char **argv)
+{
+    if (argc != 3 && argc != 4) {
+        printf ("Usage: %s num-elements num-threads [num-bins]\n", argv[0]);
+        printf ("num-bins: keys are in [0, num-bins) (default %d)\n", NUM_BINS);
+        exit (EXIT_FAILURE);
+    }
+
+    int num_elements = atoi (argv[1]);
+    int num_threads = atoi (argv[2]);
+    int num_bins = (argc == 4) ? atoi (argv[3]) : NUM_BINS;
+    if (num_elements < 1 || num_threads < 1 || num_bins < 1) {
+        printf ("num-elements, num-threads and num-bins must be positive\n");
+        exit (EXIT_FAILURE);
+    }
+
+    int *keys = (int *) malloc (num_elements * sizeof (int));
+    int *reference = (int *) malloc (num_bins * sizeof (int));
+    if (keys == NULL || reference == NULL) {
+        perror ("Malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    srand (time (NULL));
+    for (int input = 0; input < 2; input++) {
+        if (input == 0) {
+            printf ("\n%d keys uniform over %d bins, %d threads\n", num_elements, num_bins, num_threads);
+            for (int i = 0; i < num_elements; i++)
+                keys[i] = (int) ((double) rand () / ((double) RAND_MAX + 1.0) * num_bins);
+        } else {
+            printf ("\n%d keys all in bin 0, %d threads\n", num_elements, num_threads);
+            memset (keys, 0, num_elements * sizeof (int));
+        }
+
+        histogram_serial (keys, num_elements, reference, num_bins, 1);
+        printf ("%-12s %12s %14s %8s\n", "method", "time (s)", "keys/s", "check");
+        time_histogram ("serial", histogram_serial, keys, num_elements, num_bins, num_threads, reference);
+        time_histogram ("interleaved", histogram_interleaved, keys, num_elements, num_bins, num_threads, reference);
+        time_histogram ("mutex merge", histogram_mutex_merge, keys, num_elements, num_bins, num_threads, reference);
+        time_histogram ("privatized", compute_histogram_pthreads, keys, num_elements, num_bins, num_threads, reference);
+    }
+
+    free ((void *) keys);
+    free ((void *) reference);
+    exit (EXIT_SUCCESS);
+}
+
+/* Run fn NUM_RUNS times, print the fastest time and whether it matches reference. */
+void
+time_histogram (const char *name, HISTOGRAM_FN fn, const int *keys, int num_elements, int num_bins,
+                int num_threads, const int *reference)
+{
+    struct timeval start, stop;
+    double best = 0.0;
+    int *bin = (int *) malloc (num_bins * sizeof (int));
+    if (bin == NULL) {
+        perror ("Malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    for (int run = 0; run < NUM_RUNS; run++) {
+        gettimeofday (&start, NULL); /* Start timer */
+        fn (keys, num_elements, bin, num_bins, num_threads);
+        gettimeofday (&stop, NULL); /* End timer */
+        double time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
+        if (run == 0 || time_taken < best)
+            best = time_taken;
+    }
+    int status = (memcmp (bin, reference, num_bins * sizeof (int)) == 0);
+    printf ("%-12s %12f %14e %8s\n", name, best, num_elements/best, status ? "passed" : "FAILED");
+    free ((void *) bin);
+}
+
+/* One thread, one counter per bin. */
+void
+histogram_serial (const int *keys, int num_elements, int *bin, int num_bins, int num_threads)
+{
+    memset (bin, 0, num_bins * sizeof (int));
+    for (int i = 0; i < num_elements; i++)
+        bin[keys[i]]++;
+}
+
+/* One thread, interleaved counters. */
+void
+histogram_interleaved (const int *keys, int num_elements, int *bin, int num_bins, int num_threads)
+{
+    histogram_count (keys, 0, num_elements, bin, num_bins);
+}
+
+/* Private histograms merged into bin under one mutex per bin. */
+void
+histogram_mutex_merge (const int *keys, int num_elements, int *bin, int num_bins, int num_threads)
+{
+    pthread_t *tid = (pthread_t *) malloc (sizeof (pthread_t) * num_threads);
+    ARGS_FOR_THREAD *args_for_thread = (ARGS_FOR_THREAD *) malloc (sizeof (ARGS_FOR_THREAD) * num_threads);
+    pthread_mutex_t *mutex_for_bin = (pthread_mutex_t *) malloc (sizeof (pthread_mutex_t) * num_bins);
+    int i;
+
+    if (tid == NULL || args_for_thread == NULL || mutex_for_bin == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    for (i = 0; i < num_bins; i++)
+        pthread_mutex_init (&mutex_for_bin[i], NULL);
+    memset (bin, 0, num_bins * sizeof (int));
+
+    for (i = 0; i < num_threads; i++) {
+        args_for_thread[i].tid = i;
+        args_for_thread[i].num_threads = num_threads;
+        args_for_thread[i].keys = keys;
+        args_for_thread[i].num_elements = num_elements;
+        args_for_thread[i].bin = bin;
+        args_for_thread[i].num_bins = num_bins;
+        args_for_thread[i].mutex_for_bin = mutex_for_bin;
+        if ((pthread_create (&tid[i], NULL, mutex_merge_pthreads, (void *) &args_for_thread[i])) != 0) {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < num_threads; i++)
+        pthread_join (tid[i], NULL);
+
+    for (i = 0; i < num_bins; i++)
+        pthread_mutex_destroy (&mutex_for_bin[i]);
+    free ((void *) mutex_for_bin);
+    free ((void *) args_for_thread);
+    free ((void *) tid);
+}
+
+/* Body of a mutex merge thread, the thread_arr of counting_sort.c before histogram.c. */
+void *
+mutex_merge_pthreads (void *args)
+{
+    ARGS_FOR_THREAD *args_for_me = (ARGS_FOR_THREAD *) args;
+    int num_bins = args_for_me->num_bins;
+    int step = args_for_me->num_elements / args_for_me->num_threads;
+    int start = args_for_me->tid * step;
+    int end = (args_for_me->tid == args_for_me->num_threads - 1) ? args_for_me->num_elements : start + step;
+    int i;
+
+    int *part_bin = (int *) calloc (num_bins, sizeof (int));
+    if (part_bin == NULL) {
+        perror ("Malloc");
+        exit (EXIT_FAILURE);
+    }
+    for (i = start; i < end; i++)
+        part_bin[args_for_me->keys[i]]++;
+
+    for (i = 0; i < num_bins; i++) {
+        pthread_mutex_lock (&args_for_me->mutex_for_bin[i]);
+        args_for_me->bin[i] += part_bin[i];
+        pthread_mutex_unlock (&args_for_me->mutex_for_bin[i]);
+    }
+
+    free ((void *) part_bin);
+    return NULL;
+}
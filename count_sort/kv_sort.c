@@ -0,0 +1,470 @@
+/* Program to perform a stable counting sort of records carrying payloads
+ *
+ * Date created: October 17, 2026
+ *
+ * Compile as follows: gcc -o kv_sort kv_sort.c histogram.c -std=c99 -Wall -O3 -lpthread -lm
+ *
+ * counting_sort.c rebuilds the output from the histogram alone
+ * (sorted_array[idx++] = i), which only works for bare keys. Here the
+ * records themselves are moved, so a key can carry a payload, and equal
+ * keys keep their input order. Three forms are offered:
+ *
+ *  - sort_records_pthreads: an array of structs, each record starting with
+ *    its int key
+ *  - sort_key_value_pthreads: separate key and payload arrays
+ *  - sort_permutation_pthreads: only the permutation, the index of the
+ *    input element that goes to each output position, for payloads too
+ *    large to be worth moving
+ *
+ * All three run the same threads. Each thread counts the keys of its
+ * block of histogram_block into its own histogram, one thread turns the
+ * histograms into the first output position of every (key, thread) pair
+ * with histogram_offsets, and each thread then moves its block in order. A thread's records with one key therefore land after
+ * those of lower threads and in their input order, which keeps the sort
+ * stable.
+ */
+
+#define _GNU_SOURCE     /* pthread_barrier_t is hidden by -std=c99 otherwise */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <pthread.h>
+#include "histogram.h"
+
+/* Do not change the range value. */
+#define MIN_VALUE 0
+#define MAX_VALUE 1023
+
+#define PAYLOAD_SIZE 16         /* Default payload bytes per record */
+
+/* Comment out if you don't need debug info */
+// #define DEBUG
+
+/* Structure used to pass arguments to the worker threads */
+typedef struct args_for_thread_t {
+    int tid;                            /* The thread ID */
+    int num_threads;                    /* Number of worker threads */
+    int num_elements;                   /* Number of elements */
+    int range;
+    const char *keys;                   /* Key of element i at keys + i * key_stride */
+    size_t key_stride;
+    const char *payloads;               /* Payload of element i at payloads + i * payload_size, NULL if none */
+    size_t payload_size;
+    int *sorted_keys;                   /* NULL if the keys travel inside the payloads */
+    char *sorted_payloads;
+    int *permutation;                   /* Set to get only the permutation */
+} ARGS_FOR_THREAD;
+
+/* Global variables for all threads */
+int **hist_multi;                       /* hist_multi[tid][key]: count, then output position, of the key in the block of thread tid */
+pthread_barrier_t barrier_multi;
+
+int compute_gold (const char *, char *, size_t, int, int);
+int rand_int (int, int);
+void sort_records_pthreads (const void *, void *, size_t, int, int, int);
+void sort_key_value_pthreads (const int *, const void *, size_t, int *, void *, int, int, int);
+void sort_permutation_pthreads (const int *, int *, int, int, int);
+void run_sort_pthreads (ARGS_FOR_THREAD *, int);
+void* scatter_pthreads (void *);
+int check_if_sorted_and_stable (const char *, size_t, int);
+
+int
+main (int argc, char **argv)
+{
+    if (argc != 3 && argc != 4) {
+        printf ("Usage: %s num-elements num-threads [payload-bytes]\n", argv[0]);
+        printf ("payload-bytes: bytes carried with every key, at least %d (default %d)\n", (int) sizeof (int), PAYLOAD_SIZE);
+        exit (EXIT_FAILURE);
+    }
+
+    int num_elements = atoi (argv[1]);
+    int num_threads = atoi (argv[2]);
+    int payload_size = (argc == 4) ? atoi (argv[3]) : PAYLOAD_SIZE;
+    if (num_elements < 1 || num_threads < 1 || payload_size < (int) sizeof (int)) {
+        printf ("num-elements and num-threads must be positive and payload-bytes at least %d\n", (int) sizeof (int));
+        exit (EXIT_FAILURE);
+    }
+
+    int range = MAX_VALUE - MIN_VALUE;
+    size_t record_size = sizeof (int) + payload_size;
+    struct timeval start, stop;
+    double time_taken;
+    int status, i;
+
+    /* Records are the key followed by the payload, which starts with the
+     * record's input index so the stability of the sort can be checked. */
+    printf ("Generating %d records with keys in the range 0 to %d and %d byte payloads\n", num_elements, range, payload_size);
+    char *records = (char *) malloc (num_elements * record_size);
+    int *keys = (int *) malloc (num_elements * sizeof (int));
+    char *payloads = (char *) malloc ((size_t) num_elements * payload_size);
+    if (records == NULL || keys == NULL || payloads == NULL) {
+        printf ("Cannot malloc memory for the input records. \n");
+        exit (EXIT_FAILURE);
+    }
+    srand (time (NULL));
+    for (i = 0; i < num_elements; i++) {
+        char *record = records + i * record_size;
+        int key = rand_int (MIN_VALUE, MAX_VALUE);
+        memcpy (record, &key, sizeof (int));
+        memcpy (record + sizeof (int), &i, sizeof (int));
+        for (int j = sizeof (int); j < payload_size; j++)
+            record[sizeof (int) + j] = (char) (i * 31 + j);
+        keys[i] = key;
+        memcpy (payloads + (size_t) i * payload_size, record + sizeof (int), payload_size);
+    }
+
+    /* Sort the records using the reference implementation. */
+    printf ("\nSorting records using serial version\n");
+    char *sorted_reference = (char *) malloc (num_elements * record_size);
+    if (sorted_reference == NULL) {
+        perror ("Malloc");
+        exit (EXIT_FAILURE);
+    }
+    gettimeofday (&start, NULL); /* Start timer */
+    status = compute_gold (records, sorted_reference, record_size, num_elements, range);
+    gettimeofday (&stop, NULL); /* End timer */
+    time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
+    printf ("Execution time = %fs\n", time_taken);
+    if (status == 0) {
+        exit (EXIT_FAILURE);
+    }
+    if (check_if_sorted_and_stable (sorted_reference, record_size, num_elements) == 0) {
+        printf ("Error sorting the records using the reference code\n");
+        exit (EXIT_FAILURE);
+    }
+    printf ("Stable counting sort was successful using reference version\n");
+
+    /* Array of structs. */
+    printf ("\nSorting records as an array of structs using pthreads\n");
+    char *sorted_records = (char *) malloc (num_elements * record_size);
+    if (sorted_records == NULL) {
+        perror ("Malloc");
+        exit (EXIT_FAILURE);
+    }
+    gettimeofday (&start, NULL); /* Start timer */
+    sort_records_pthreads (records, sorted_records, record_size, num_elements, range, num_threads);
+    gettimeofday (&stop, NULL); /* End timer */
+    time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
+    printf ("Execution time = %fs\n", time_taken);
+    status = (memcmp (sorted_reference, sorted_records, num_elements * record_size) == 0);
+    printf ("%s\n", status ? "Test passed" : "Test failed");
+    free ((void *) sorted_records);
+
+    /* Separate key and payload arrays. */
+    printf ("\nSorting separate key and payload arrays using pthreads\n");
+    int *sorted_keys = (int *) malloc (num_elements * sizeof (int));
+    char *sorted_payloads = (char *) malloc ((size_t) num_elements * payload_size);
+    if (sorted_keys == NULL || sorted_payloads == NULL) {
+        perror ("Malloc");
+        exit (EXIT_FAILURE);
+    }
+    gettimeofday (&start, NULL); /* Start timer */
+    sort_key_value_pthreads (keys, payloads, payload_size, sorted_keys, sorted_payloads, num_elements, range, num_threads);
+    gettimeofday (&stop, NULL); /* End timer */
+    time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
+    printf ("Execution time = %fs\n", time_taken);
+    status = 1;
+    for (i = 0; i < num_elements && status; i++) {
+        const char *expected = sorted_reference + i * record_size;
+        status = (memcmp (expected, &sorted_keys[i], sizeof (int)) == 0
+                  && memcmp (expected + sizeof (int), sorted_payloads + (size_t) i * payload_size, payload_size) == 0);
+    }
+    printf ("%s\n", status ? "Test passed" : "Test failed");
+    free ((void *) sorted_keys);
+    free ((void *) sorted_payloads);
+
+    /* Permutation only. */
+    printf ("\nComputing the sorting permutation using pthreads\n");
+    int *permutation = (int *) malloc (num_elements * sizeof (int));
+    if (permutation == NULL) {
+        perror ("Malloc");
+        exit (EXIT_FAILURE);
+    }
+    gettimeofday (&start, NULL); /* Start timer */
+    sort_permutation_pthreads (keys, permutation, num_elements, range, num_threads);
+    gettimeofday (&stop, NULL); /* End timer */
+    time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
+    printf ("Execution time = %fs\n", time_taken);
+    status = 1;
+    for (i = 0; i < num_elements && status; i++)
+        status = (memcmp (sorted_reference + i * record_size, records + permutation[i] * record_size, record_size) == 0);
+    printf ("%s\n", status ? "Test passed" : "Test failed");
+    free ((void *) permutation);
+
+    free ((void *) records);
+    free ((void *) keys);
+    free ((void *) payloads);
+    free ((void *) sorted_reference);
+    exit (EXIT_SUCCESS);
+}
+
+/* Key of a record. */
+static inline int
+record_key (const char *record)
+{
+    int key;
+    memcpy (&key, record, sizeof (int));
+    return key;
+}
+
+/* Copy one payload, with the common sizes unrolled at compile time. */
+static inline void
+copy_payload (char *dst, const char *src, size_t size)
+{
+    switch (size) {
+        case 8:
+            memcpy (dst, src, 8);
+            break;
+        case 16:
+            memcpy (dst, src, 16);
+            break;
+        case 32:
+            memcpy (dst, src, 32);
+            break;
+        case 64:
+            memcpy (dst, src, 64);
+            break;
+        default:
+            memcpy (dst, src, size);
+    }
+}
+
+/* Reference implementation: serial stable counting sort of the records. */
+int
+compute_gold (const char *records, char *sorted_records, size_t record_size, int num_elements, int range)
+{
+    int i;
+    int num_bins = range + 1;
+    int *bin = (int *) calloc (num_bins, sizeof (int));
+    if (bin == NULL) {
+        perror ("Malloc");
+        return 0;
+    }
+
+    for (i = 0; i < num_elements; i++)
+        bin[record_key (records + i * record_size)]++;
+
+    /* Turn the histogram into the first output position of every key. */
+    int sum = 0;
+    for (i = 0; i < num_bins; i++) {
+        int count = bin[i];
+        bin[i] = sum;
+        sum += count;
+    }
+
+    for (i = 0; i < num_elements; i++) {
+        const char *record = records + i * record_size;
+        memcpy (sorted_records + bin[record_key (record)]++ * record_size, record, record_size);
+    }
+
+    free ((void *) bin);
+    return 1;
+}
+
+/*------------------------------------------------------------------
+ * Function:    sort_records_pthreads
+ * Purpose:     Stable sort of num_elements records of record_size bytes,
+ *              each starting with an int key in [0, range], by key
+ *
+ * Input args:  records, record_size, num_elements, range, num_threads
+ * Output args: sorted_records
+ * Return val:  none
+ */  /*  */
+void
+sort_records_pthreads (const void *records, void *sorted_records, size_t record_size, int num_elements,
+                       int range, int num_threads)
+{
+    ARGS_FOR_THREAD args;
+
+    memset (&args, 0, sizeof (args));
+    args.num_elements = num_elements;
+    args.range = range;
+    args.keys = (const char *) records;
+    args.key_stride = record_size;
+    args.payloads = (const char *) records;     /* the whole record is the payload */
+    args.payload_size = record_size;
+    args.sorted_payloads = (char *) sorted_records;
+    run_sort_pthreads (&args, num_threads);
+}
+
+/*------------------------------------------------------------------
+ * Function:    sort_key_value_pthreads
+ * Purpose:     Stable sort of keys in [0, range] and the payloads of
+ *              payload_size bytes that go with them, by key
+ *
+ * Input args:  keys, payloads, payload_size, num_elements, range,
+ *              num_threads
+ * Output args: sorted_keys, sorted_payloads
+ * Return val:  none
+ */  /*  */
+void
+sort_key_value_pthreads (const int *keys, const void *payloads, size_t payload_size, int *sorted_keys,
+                         void *sorted_payloads, int num_elements, int range, int num_threads)
+{
+    ARGS_FOR_THREAD args;
+
+    memset (&args, 0, sizeof (args));
+    args.num_elements = num_elements;
+    args.range = range;
+    args.keys = (const char *) keys;
+    args.key_stride = sizeof (int);
+    args.payloads = (const char *) payloads;
+    args.payload_size = payload_size;
+    args.sorted_keys = sorted_keys;
+    args.sorted_payloads = (char *) sorted_payloads;
+    run_sort_pthreads (&args, num_threads);
+}
+
+/*------------------------------------------------------------------
+ * Function:    sort_permutation_pthreads
+ * Purpose:     Stable sort of keys in [0, range] that moves nothing:
+ *              permutation[i] is the index of the key that sorts to
+ *              position i
+ *
+ * Input args:  keys, num_elements, range, num_threads
+ * Output args: permutation
+ * Return val:  none
+ */  /*  */
+void
+sort_permutation_pthreads (const int *keys, int *permutation, int num_elements, int range, int num_threads)
+{
+    ARGS_FOR_THREAD args;
+
+    memset (&args, 0, sizeof (args));
+    args.num_elements = num_elements;
+    args.range = range;
+    args.keys = (const char *) keys;
+    args.key_stride = sizeof (int);
+    args.permutation = permutation;
+    run_sort_pthreads (&args, num_threads);
+}
+
+/* Run scatter_pthreads on num_threads threads, each with a copy of args and its own tid. */
+void
+run_sort_pthreads (ARGS_FOR_THREAD *args, int num_threads)
+{
+    int num_bins = args->range + 1;
+    int i;
+
+    pthread_t *tid = (pthread_t *) malloc (sizeof (pthread_t) * num_threads); /* Data structure to store the thread IDs */
+    ARGS_FOR_THREAD *args_for_thread = (ARGS_FOR_THREAD *) malloc (sizeof (ARGS_FOR_THREAD) * num_threads);
+    if (tid == NULL || args_for_thread == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    hist_multi = histogram_alloc (num_threads, num_bins);
+    pthread_barrier_init (&barrier_multi, NULL, num_threads);
+
+    for (i = 0; i < num_threads; i++) {
+        args_for_thread[i] = *args;
+        args_for_thread[i].tid = i;
+        args_for_thread[i].num_threads = num_threads;
+
+        if ((pthread_create (&tid[i], NULL, scatter_pthreads, (void *) &args_for_thread[i])) != 0) {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    /* Wait for the workers to finish */
+    for (i = 0; i < num_threads; i++)
+        pthread_join (tid[i], NULL);
+
+    /* Free data structures */
+    pthread_barrier_destroy (&barrier_multi);
+    histogram_free (hist_multi, num_threads);
+    free ((void *) args_for_thread);
+    free ((void *) tid);
+}
+
+/*------------------------------------------------------------------
+ * Function:    scatter_pthreads
+ * Purpose:     Body of a worker: count the keys of the thread's block, wait
+ *              for the output positions, then move the block's elements, or
+ *              write their indices, to the positions in order
+ *
+ * Input args:  args (thread argument structure)
+ * Return val:  NULL
+ */  /*  */
+void *
+scatter_pthreads (void *args)
+{
+    ARGS_FOR_THREAD *args_for_me = (ARGS_FOR_THREAD *) args;
+    int tid = args_for_me->tid;
+    int num_threads = args_for_me->num_threads;
+    int num_bins = args_for_me->range + 1;
+    const char *keys = args_for_me->keys;
+    size_t key_stride = args_for_me->key_stride;
+    size_t payload_size = args_for_me->payload_size;
+    int *offset = hist_multi[tid];
+    int i, start, end;
+
+    histogram_block (args_for_me->num_elements, tid, num_threads, &start, &end);
+
+    /* Histogram of this thread's block. */
+    for (i = start; i < end; i++)
+        offset[record_key (keys + i * key_stride)]++;
+
+    if (pthread_barrier_wait (&barrier_multi) == PTHREAD_BARRIER_SERIAL_THREAD)
+        histogram_offsets (hist_multi, num_threads, num_bins);
+    pthread_barrier_wait (&barrier_multi);
+
+    /* Move the block in input order, which keeps equal keys in order. */
+    if (args_for_me->permutation != NULL) {
+        int *permutation = args_for_me->permutation;
+        for (i = start; i < end; i++)
+            permutation[offset[record_key (keys + i * key_stride)]++] = i;
+    } else if (args_for_me->sorted_keys != NULL) {
+        const char *payloads = args_for_me->payloads;
+        int *sorted_keys = args_for_me->sorted_keys;
+        char *sorted_payloads = args_for_me->sorted_payloads;
+        for (i = start; i < end; i++) {
+            int key = record_key (keys + i * key_stride);
+            int pos = offset[key]++;
+            sorted_keys[pos] = key;
+            copy_payload (sorted_payloads + pos * payload_size, payloads + i * payload_size, payload_size);
+        }
+    } else {
+        const char *payloads = args_for_me->payloads;
+        char *sorted_payloads = args_for_me->sorted_payloads;
+        for (i = start; i < end; i++) {
+            int pos = offset[record_key (keys + i * key_stride)]++;
+            copy_payload (sorted_payloads + pos * payload_size, payloads + i * payload_size, payload_size);
+        }
+    }
+
+    return NULL;
+}
+
+/* Check that the records are sorted by key and that equal keys kept their input order. */
+int
+check_if_sorted_and_stable (const char *records, size_t record_size, int num_elements)
+{
+    int status = 1;
+    for (int i = 1; i < num_elements; i++) {
+        const char *prev = records + (i - 1) * record_size, *this = records + i * record_size;
+        int prev_index, this_index;
+        memcpy (&prev_index, prev + sizeof (int), sizeof (int));
+        memcpy (&this_index, this + sizeof (int), sizeof (int));
+        if (record_key (prev) > record_key (this)
+            || (record_key (prev) == record_key (this) && prev_index > this_index)) {
+            status = 0;
+            break;
+        }
+    }
+
+    return status;
+}
+
+/* Returns a random integer between [min, max]. */
+int
+rand_int (int min, int max)
+{
+    float r = rand ()/(float) RAND_MAX;
+    return (int) floorf (min + (max - min) * r);
+}
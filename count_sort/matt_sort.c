@@ -3,9 +3,11 @@
  * Author: Naga Kandasamy
  * Date created: February 24, 2020
  * 
- * Compile as follows: gcc -o matt_sort matt_sort.c -std=c99 -Wall -O3 -lpthread -lm
+ * Compile as follows: gcc -o matt_sort matt_sort.c histogram.c -std=c99 -Wall -O3 -lpthread -lm
  */
 
+#define _GNU_SOURCE     /* pthread_barrier_t is hidden by -std=c99 otherwise */
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
@@ -15,6 +17,7 @@
 #include <limits.h>
 #include <time.h>
 #include <pthread.h>
+#include "histogram.h"
 
 /* Do not change the range value. */
 #define MIN_VALUE 0 
@@ -29,7 +32,8 @@ typedef struct args_for_thread_t {
     int num_elements;
     int range;
     int *glob_bin; /* Global histogram */
-    pthread_mutex_t *bin_mutex; /* Locks for each bin */
+    int **sub_bin; /* Private histogram of each thread, merged into glob_bin */
+    pthread_barrier_t *barrier; /* Between counting and merging */
 } ARGS_FOR_THREAD;
 
 /* Comment out if you don't need debug info */
@@ -166,25 +170,24 @@ thread_job(void*args)
     ARGS_FOR_THREAD *args_for_me = (ARGS_FOR_THREAD *) args; /* Typecast the argument to a pointer the the ARGS_FOR_THREAD structure */
     
     /* Compute histogram. Generate bin for each element within 
-     * the range. 
+     * the range. Each thread counts a contiguous block into its own bins.
      * */
-    int i;
     int num_bins = args_for_me->range + 1;
-    int *bin = (int *) malloc (num_bins * sizeof (int));    
-    if (bin == NULL) {
-        perror ("Malloc");
-        exit (EXIT_FAILURE);
-    }
-    memset(bin, 0, num_bins); /* Initialize histogram bins to zero */ 
-    
-    for (i = args_for_me->tid; i < args_for_me->num_elements; i+=args_for_me->num_threads) {
-        bin[args_for_me->input_array[i]]++;
-    }
-    for (i = 0; i < num_bins; i++) {
-        pthread_mutex_lock(&args_for_me->bin_mutex[i]);
-        args_for_me->glob_bin[i] += bin[i];
-        pthread_mutex_unlock(&args_for_me->bin_mutex[i]);
-    }
+    int tid = args_for_me->tid;
+    int num_threads = args_for_me->num_threads;
+    int start, end;
+
+    histogram_block (args_for_me->num_elements, tid, num_threads, &start, &end);
+    histogram_count (args_for_me->input_array, start, end, args_for_me->sub_bin[tid], num_bins);
+
+    /* Merge: once every thread has counted, each one sums its slice of the bins */
+    pthread_barrier_wait (args_for_me->barrier);
+    histogram_merge (args_for_me->sub_bin, num_threads, args_for_me->glob_bin, num_bins, tid, num_threads);
+
+    /* Generate the sorted array: once all bins are merged, each thread writes an equal share */
+    pthread_barrier_wait (args_for_me->barrier);
+    histogram_fill (args_for_me->glob_bin, num_bins, args_for_me->sorted_array, args_for_me->num_elements,
+                    tid, num_threads);
 
     pthread_exit ((void *)0);
 }
@@ -193,7 +196,7 @@ thread_job(void*args)
 void 
 compute_using_pthreads (int *input_array, int *sorted_array, int num_elements, int range, int num_threads)
 {
-    int i, j;
+    int i;
 
     pthread_t *tid = (pthread_t *) malloc (sizeof (pthread_t) * num_threads); /* Data structure to store the thread IDs */
     if (tid == NULL) {
@@ -201,15 +204,9 @@ compute_using_pthreads (int *input_array, int *sorted_array, int num_elements, i
         exit (EXIT_FAILURE);
     }
     int num_bins = range + 1;
-    pthread_mutex_t *bin_mutex = (pthread_mutex_t *) malloc(sizeof (pthread_mutex_t) * num_bins );
-    if (bin_mutex == NULL) {
-        perror ("malloc");
-        exit (EXIT_FAILURE);
-    }
-
-    for (i = 0; i < num_bins; i++) {
-        pthread_mutex_init (&bin_mutex[i], NULL);
-    }
+    int **sub_bin = histogram_alloc (num_threads, num_bins);
+    pthread_barrier_t barrier;
+    pthread_barrier_init (&barrier, NULL, num_threads);
 
     // Initialize global histogram
     int *glob_bin;
@@ -231,7 +228,8 @@ compute_using_pthreads (int *input_array, int *sorted_array, int num_elements, i
         args_for_thread[i]->num_threads = num_threads;
         args_for_thread[i]->num_elements = num_elements;
         args_for_thread[i]->range = range;
-        args_for_thread[i]->bin_mutex = bin_mutex;
+        args_for_thread[i]->sub_bin = sub_bin;
+        args_for_thread[i]->barrier = &barrier;
         args_for_thread[i]->glob_bin = glob_bin;
     }
 
@@ -240,22 +238,16 @@ compute_using_pthreads (int *input_array, int *sorted_array, int num_elements, i
         pthread_create (&tid[i], NULL, thread_job, (void *) args_for_thread[i]);
     }
 
-    /* Wait for the workers to finish */
+    /* Wait for the workers to finish, they generate the sorted array too */
     for(i = 0; i < num_threads; i++)
         pthread_join (tid[i], NULL);
-
-    /* Generate the sorted array. */
-    int idx = 0;
-    for (i = 0; i < num_bins; i++) {
-        for (j = 0; j < glob_bin[i]; j++) {
-            sorted_array[idx++] = i;
-        }
-    }
     gettimeofday (&stop, NULL);
 
     /* Free data structures */
     for(i = 0; i < num_threads; i++)
         free ((void *) args_for_thread[i]);
+    pthread_barrier_destroy (&barrier);
+    histogram_free (sub_bin, num_threads);
 
 }
 
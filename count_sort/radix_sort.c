@@ -0,0 +1,352 @@
+/* Program to perform LSD radix sort on arbitrary 32-bit integer keys
+ *
+ * Date created: October 17, 2026
+ *
+ * Compile as follows: gcc -o radix_sort radix_sort.c histogram.c -std=c99 -Wall -O3 -lpthread -lm
+ *
+ * counting_sort.c only sorts keys in [MIN_VALUE, MAX_VALUE]. This program
+ * sorts any int by running a counting sort on one digit of digit-bits bits
+ * per pass, least significant digit first: 4 passes with 8-bit digits, 3
+ * with 11-bit ones. Every pass is stable, so the order the earlier digits
+ * set is kept among keys with the same digit. The sign bit is flipped
+ * before the top digit is taken, so negative keys sort before the others.
+ *
+ * The threads are created once and split the array into the blocks of
+ * histogram_block. In every pass each thread counts the digits of its
+ * block into its own histogram, one thread turns the histograms into the
+ * position every thread writes each digit to with histogram_offsets, and
+ * each thread scatters its block. The scatter goes through a SCATTER_BUFFER key buffer per digit, so
+ * the output is written a cache line at a time instead of one key to each
+ * of num_bins places in turn.
+ */
+
+#define _GNU_SOURCE     /* pthread_barrier_t is hidden by -std=c99 otherwise */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <pthread.h>
+#include "histogram.h"
+
+#define KEY_BITS 32
+#define DIGIT_BITS 8            /* Default bits per pass, 8 or 11 */
+#define SCATTER_BUFFER 16       /* Keys buffered per digit before they are written, one 64-byte line */
+
+/* Digit of key starting at bit shift, with the sign bit flipped so negative keys come first */
+#define DIGIT(key, shift, mask) ((((unsigned int) (key) ^ 0x80000000u) >> (shift)) & (mask))
+
+/* Comment out if you don't need debug info */
+// #define DEBUG
+
+/* Structure used to pass arguments to the worker threads */
+typedef struct args_for_thread_t {
+    int tid;                            /* The thread ID */
+    int num_threads;                    /* Number of worker threads */
+    int *input_array;
+    int *sorted_array;
+    int *temp_array;                    /* Output of every other pass */
+    int num_elements;                   /* Number of elements */
+    int digit_bits;                     /* Bits sorted per pass */
+} ARGS_FOR_THREAD;
+
+/* Global variables for all threads */
+int **hist_multi;                       /* hist_multi[tid][digit]: count, then output position, of the digit in the block of thread tid */
+pthread_barrier_t barrier_multi;
+
+int compute_gold (int *, int *, int);
+int rand_key (void);
+void print_array (int *, int);
+void compute_using_pthreads (int *, int *, int, int, int);
+int check_if_sorted (int *, int);
+int compare_results (int *, int *, int);
+void* radix_pass_pthreads (void *);
+
+int
+main (int argc, char **argv)
+{
+    if (argc != 3 && argc != 4) {
+        printf ("Usage: %s num-elements num-threads [digit-bits]\n", argv[0]);
+        printf ("digit-bits: bits sorted per pass, 8 (default) or 11\n");
+        exit (EXIT_FAILURE);
+    }
+
+    int num_elements = atoi (argv[1]);
+    int num_threads = atoi (argv[2]);
+    int digit_bits = (argc == 4) ? atoi (argv[3]) : DIGIT_BITS;
+    if (num_elements < 1 || num_threads < 1 || (digit_bits != 8 && digit_bits != 11)) {
+        printf ("num-elements and num-threads must be positive and digit-bits 8 or 11\n");
+        exit (EXIT_FAILURE);
+    }
+
+    int *input_array, *sorted_array_reference, *sorted_array_d;
+    struct timeval start, stop;
+    double time_taken;
+
+    /* Populate the input array with random 32-bit integers. */
+    printf ("Generating input array with %d random 32-bit elements\n", num_elements);
+    input_array = (int *) malloc (num_elements * sizeof (int));
+    if (input_array == NULL) {
+        printf ("Cannot malloc memory for the input array. \n");
+        exit (EXIT_FAILURE);
+    }
+    srand (time (NULL));
+    for (int i = 0; i < num_elements; i++)
+        input_array[i] = rand_key ();
+
+#ifdef DEBUG
+    print_array (input_array, num_elements);
+#endif
+
+    /* Sort the elements in the input array using the reference implementation.
+     * The result is placed in sorted_array_reference. */
+    printf ("\nSorting array using qsort\n");
+    int status;
+    sorted_array_reference = (int *) malloc (num_elements * sizeof (int));
+    if (sorted_array_reference == NULL) {
+        perror ("Malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    gettimeofday (&start, NULL); /* Start timer */
+    status = compute_gold (input_array, sorted_array_reference, num_elements);
+    gettimeofday (&stop, NULL); /* End timer */
+    time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
+    printf ("Execution time = %fs\n", time_taken);
+
+    if (status == 0) {
+        exit (EXIT_FAILURE);
+    }
+
+    status = check_if_sorted (sorted_array_reference, num_elements);
+    if (status == 0) {
+        printf ("Error sorting the input array using the reference code\n");
+        exit (EXIT_FAILURE);
+    }
+
+    printf ("Sorting was successful using reference version\n");
+
+#ifdef DEBUG
+    print_array (sorted_array_reference, num_elements);
+#endif
+
+    /* Sort the elements with the parallel radix sort. */
+    printf ("\nSorting array using pthreads, %d-bit digits\n", digit_bits);
+    sorted_array_d = (int *) malloc (num_elements * sizeof (int));
+    if (sorted_array_d == NULL) {
+        perror ("Malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    gettimeofday (&start, NULL); /* Start timer */
+    compute_using_pthreads (input_array, sorted_array_d, num_elements, num_threads, digit_bits);
+    gettimeofday (&stop, NULL); /* End timer */
+    time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
+    printf ("Execution time = %fs\n", time_taken);
+    printf ("Keys sorted per second: %e\n", num_elements/time_taken);
+
+    /* Check the two results for correctness. */
+    printf ("\nComparing reference and pthread results\n");
+    status = compare_results (sorted_array_reference, sorted_array_d, num_elements);
+    if (status == 1)
+        printf ("Test passed\n");
+    else
+        printf ("Test failed\n");
+
+    free ((void *) input_array);
+    free ((void *) sorted_array_reference);
+    free ((void *) sorted_array_d);
+    exit (EXIT_SUCCESS);
+}
+
+/* Order two ints for qsort. */
+static int
+compare_keys (const void *a, const void *b)
+{
+    int x = *(const int *) a, y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
+/* Reference implementation: qsort a copy of the input. */
+int
+compute_gold (int *input_array, int *sorted_array, int num_elements)
+{
+    memcpy (sorted_array, input_array, num_elements * sizeof (int));
+    qsort (sorted_array, num_elements, sizeof (int), compare_keys);
+    return 1;
+}
+
+/*------------------------------------------------------------------
+ * Function:    compute_using_pthreads
+ * Purpose:     Sort input_array into sorted_array with num_threads threads,
+ *              digit_bits bits per pass. input_array is left as it is
+ *
+ * Input args:  input_array, num_elements, num_threads, digit_bits
+ * Output args: sorted_array
+ * Return val:  none
+ */  /*  */
+void
+compute_using_pthreads (int *input_array, int *sorted_array, int num_elements, int num_threads, int digit_bits)
+{
+    int num_bins = 1 << digit_bits;
+    int i;
+
+    pthread_t *tid = (pthread_t *) malloc (sizeof (pthread_t) * num_threads); /* Data structure to store the thread IDs */
+    ARGS_FOR_THREAD *args_for_thread = (ARGS_FOR_THREAD *) malloc (sizeof (ARGS_FOR_THREAD) * num_threads);
+    int *temp_array = (int *) malloc (num_elements * sizeof (int));
+    if (tid == NULL || args_for_thread == NULL || temp_array == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    hist_multi = histogram_alloc (num_threads, num_bins);
+    pthread_barrier_init (&barrier_multi, NULL, num_threads);
+
+    for (i = 0; i < num_threads; i++) {
+        args_for_thread[i].tid = i;
+        args_for_thread[i].num_threads = num_threads;
+        args_for_thread[i].input_array = input_array;
+        args_for_thread[i].sorted_array = sorted_array;
+        args_for_thread[i].temp_array = temp_array;
+        args_for_thread[i].num_elements = num_elements;
+        args_for_thread[i].digit_bits = digit_bits;
+
+        if ((pthread_create (&tid[i], NULL, radix_pass_pthreads, (void *) &args_for_thread[i])) != 0) {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    /* Wait for the workers to finish */
+    for (i = 0; i < num_threads; i++)
+        pthread_join (tid[i], NULL);
+
+    /* Free data structures */
+    pthread_barrier_destroy (&barrier_multi);
+    histogram_free (hist_multi, num_threads);
+    free ((void *) temp_array);
+    free ((void *) args_for_thread);
+    free ((void *) tid);
+}
+
+/*------------------------------------------------------------------
+ * Function:    radix_pass_pthreads
+ * Purpose:     Body of a worker: run every pass on the thread's block of the
+ *              array, meeting the other threads at a barrier between the
+ *              counting, the prefix sum and the scatter. The passes
+ *              alternate between temp_array and sorted_array so the last one
+ *              writes sorted_array
+ *
+ * Input args:  args (thread argument structure)
+ * Return val:  NULL
+ */  /*  */
+void *
+radix_pass_pthreads (void *args)
+{
+    ARGS_FOR_THREAD *args_for_me = (ARGS_FOR_THREAD *) args;
+    int tid = args_for_me->tid;
+    int num_threads = args_for_me->num_threads;
+    int digit_bits = args_for_me->digit_bits;
+    int num_bins = 1 << digit_bits;
+    unsigned int mask = num_bins - 1;
+    int num_passes = (KEY_BITS + digit_bits - 1) / digit_bits;
+    int *hist = hist_multi[tid];
+    int i, d, pass, start, end;
+
+    histogram_block (args_for_me->num_elements, tid, num_threads, &start, &end);
+
+    int *buffer = (int *) malloc (num_bins * SCATTER_BUFFER * sizeof (int));
+    int *fill = (int *) malloc (num_bins * sizeof (int));
+    if (buffer == NULL || fill == NULL) {
+        perror ("Malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    int *src = args_for_me->input_array;
+    for (pass = 0; pass < num_passes; pass++) {
+        int shift = pass * digit_bits;
+        int *dst = ((num_passes - 1 - pass) % 2 == 0) ? args_for_me->sorted_array : args_for_me->temp_array;
+
+        /* Histogram of the digit over this thread's block. */
+        memset (hist, 0, num_bins * sizeof (int));
+        for (i = start; i < end; i++)
+            hist[DIGIT (src[i], shift, mask)]++;
+
+        if (pthread_barrier_wait (&barrier_multi) == PTHREAD_BARRIER_SERIAL_THREAD)
+            histogram_offsets (hist_multi, num_threads, num_bins);
+        pthread_barrier_wait (&barrier_multi);
+
+        /* Scatter the block in order, a buffer of each digit at a time. */
+        memset (fill, 0, num_bins * sizeof (int));
+        for (i = start; i < end; i++) {
+            d = DIGIT (src[i], shift, mask);
+            int *slot = &buffer[d * SCATTER_BUFFER];
+            slot[fill[d]++] = src[i];
+            if (fill[d] == SCATTER_BUFFER) {
+                memcpy (&dst[hist[d]], slot, SCATTER_BUFFER * sizeof (int));
+                hist[d] += SCATTER_BUFFER;
+                fill[d] = 0;
+            }
+        }
+        for (d = 0; d < num_bins; d++)
+            memcpy (&dst[hist[d]], &buffer[d * SCATTER_BUFFER], fill[d] * sizeof (int));
+
+        /* the next pass reads what every thread wrote */
+        pthread_barrier_wait (&barrier_multi);
+        src = dst;
+    }
+
+    free ((void *) buffer);
+    free ((void *) fill);
+    return NULL;
+}
+
+/* Check if the array is sorted. */
+int
+check_if_sorted (int *array, int num_elements)
+{
+    int status = 1;
+    for (int i = 1; i < num_elements; i++) {
+        if (array[i - 1] > array[i]) {
+            status = 0;
+            break;
+        }
+    }
+
+    return status;
+}
+
+/* Check if the arrays elements are identical. */
+int
+compare_results (int *array_1, int *array_2, int num_elements)
+{
+    int status = 1;
+    for (int i = 0; i < num_elements; i++) {
+        if (array_1[i] != array_2[i]) {
+            status = 0;
+            break;
+        }
+    }
+
+    return status;
+}
+
+/* Returns a random integer over the full 32-bit range, rand () only gives 31 bits. */
+int
+rand_key (void)
+{
+    return (int) (((unsigned int) rand () << 16) ^ (unsigned int) rand ());
+}
+
+/* Helper function to print the given array. */
+void
+print_array (int *this_array, int num_elements)
+{
+    printf ("Array: ");
+    for (int i = 0; i < num_elements; i++)
+        printf ("%d ", this_array[i]);
+    printf ("\n");
+    return;
+}
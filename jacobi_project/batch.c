@@ -0,0 +1,285 @@
+/* Batch mode: solve many small grids at once, one grid per thread.
+ *
+ * Small plates are too small to split over a team: the barrier or the
+ * thread creation of the threaded jacobi solvers costs more than a sweep.
+ * compute_batch instead gives each worker whole problems. A worker takes
+ * the next unsolved problem with an atomic increment, solves it on its own
+ * with the Jacobi method and jacobi_row, and comes back for more, so a
+ * thread that drew large or slow problems simply takes fewer of them.
+ * Problems are handed out largest first so the last ones to start are the
+ * short ones.
+ *
+ * Each worker keeps two grids sized for the largest problem and reuses
+ * them, so no memory is allocated per problem.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include "grid.h"
+
+/* Structure that holds the arguments for the batch workers */
+typedef struct batch_args_s {
+    int tid;
+    BATCH_PROBLEM_t *problems;
+    int *order;             /* Indices of the problems, largest first */
+    int num_problems;
+    int max_dim;
+} BATCH_ARGS_t;
+
+static int next_problem;    /* Next entry of order to hand out */
+
+void * batch_worker (void *);
+
+/*------------------------------------------------------------------
+ * Function:    read_batch
+ * Purpose:     Read a batch file: one problem per line as
+ *              "dim min-temp max-temp", blank lines and lines starting
+ *              with # are skipped
+ *
+ * Input args:  path
+ * Output args: num_problems
+ * Return val:  problems, NULL if the file cannot be read or a line is bad
+ */  /*  */
+BATCH_PROBLEM_t *
+read_batch (const char *path, int *num_problems)
+{
+    char line[256];
+    int n = 0, size = 0, line_num = 0;
+    BATCH_PROBLEM_t *problems = NULL;
+
+    FILE *fp = fopen (path, "r");
+    if (fp == NULL) {
+        perror (path);
+        return NULL;
+    }
+    while (fgets (line, sizeof (line), fp) != NULL) {
+        int dim;
+        float min_temp, max_temp;
+        char *p = line + strspn (line, " \t");
+
+        line_num++;
+        if (*p == '#' || *p == '\n' || *p == '\0')
+            continue;
+        if (sscanf (p, "%d %f %f", &dim, &min_temp, &max_temp) != 3 || dim < 3) {
+            printf ("%s:%d: expected \"dim min-temp max-temp\" with dim >= 3\n", path, line_num);
+            fclose (fp);
+            free ((void *) problems);
+            return NULL;
+        }
+        if (n == size) {
+            size = (size == 0) ? 1024 : 2 * size;
+            problems = (BATCH_PROBLEM_t *) realloc (problems, size * sizeof (BATCH_PROBLEM_t));
+            if (problems == NULL) {
+                perror ("realloc");
+                exit (EXIT_FAILURE);
+            }
+        }
+        memset (&problems[n], 0, sizeof (BATCH_PROBLEM_t));
+        problems[n].dim = dim;
+        problems[n].min_temp = min_temp;
+        problems[n].max_temp = max_temp;
+        n++;
+    }
+    fclose (fp);
+    *num_problems = n;
+    return problems;
+}
+
+/* Sort problem indices by decreasing size. */
+static BATCH_PROBLEM_t *sort_problems;
+
+static int
+compare_size (const void *a, const void *b)
+{
+    int x = sort_problems[*(const int *) a].dim, y = sort_problems[*(const int *) b].dim;
+    return (y > x) - (y < x);
+}
+
+/*------------------------------------------------------------------
+ * Function:    compute_batch
+ * Purpose:     Solve every problem with the Jacobi method, each on one of
+ *              num_threads workers that pick the problems up dynamically
+ *
+ * Input args:  problems, num_problems, num_threads
+ * Output args: num_iter, time and thread of every problem
+ * Return val:  none
+ */  /*  */
+void
+compute_batch (BATCH_PROBLEM_t *problems, int num_problems, int num_threads)
+{
+    pthread_t *worker_thread = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+    BATCH_ARGS_t *args_for_thread = (BATCH_ARGS_t *) malloc (num_threads * sizeof (BATCH_ARGS_t));
+    int *order = (int *) malloc (num_problems * sizeof (int));
+    int max_dim = 3;
+    int i;
+
+    if (worker_thread == NULL || args_for_thread == NULL || order == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    for (i = 0; i < num_problems; i++) {
+        order[i] = i;
+        if (problems[i].dim > max_dim)
+            max_dim = problems[i].dim;
+    }
+    sort_problems = problems;
+    qsort (order, num_problems, sizeof (int), compare_size);
+    next_problem = 0;
+
+    for (i = 0; i < num_threads; i++) {
+        args_for_thread[i].tid = i;
+        args_for_thread[i].problems = problems;
+        args_for_thread[i].order = order;
+        args_for_thread[i].num_problems = num_problems;
+        args_for_thread[i].max_dim = max_dim;
+
+        if ((create_solver_thread (&worker_thread[i], i, num_threads, batch_worker, (void *)&args_for_thread[i])) != 0) {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < num_threads; i++)
+        pthread_join (worker_thread[i], NULL);
+
+    free ((void *) worker_thread);
+    free ((void *) args_for_thread);
+    free ((void *) order);
+}
+
+/*------------------------------------------------------------------
+ * Function:    batch_worker
+ * Purpose:     Body of a batch worker: take problems until none are left
+ *              and solve each one alone
+ *
+ * Input args:  this_arg (thread argument structure)
+ * Return val:  NULL
+ */  /*  */
+void *
+batch_worker (void *this_arg)
+{
+    BATCH_ARGS_t *args_for_me = (BATCH_ARGS_t *) this_arg;
+    size_t size = sizeof (float) * stencil_points (args_for_me->max_dim);
+    float *cur = (float *) malloc (size);
+    float *next = (float *) malloc (size);
+    float eps = 1e-6;
+    int k, j;
+
+    if (cur == NULL || next == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    for (;;) {
+        int n = __atomic_fetch_add (&next_problem, 1, __ATOMIC_RELAXED);
+        if (n >= args_for_me->num_problems)
+            break;
+        BATCH_PROBLEM_t *problem = &args_for_me->problems[args_for_me->order[n]];
+        int dim = problem->dim;
+        long num_lines = stencil_lines (dim);
+        long line;
+        struct timespec start, stop;
+
+        clock_gettime (CLOCK_MONOTONIC, &start);
+
+        /* same initial conditions as create_grid, seeded by the problem so runs repeat */
+        unsigned int seed = (unsigned int) args_for_me->order[n] + 1;
+        memset (cur, 0, sizeof (float) * stencil_points (dim));
+        int k_last = (stencil->ndim == 2) ? 0 : dim - 2;
+        for (k = (stencil->ndim == 2) ? 0 : 1; k <= k_last; k++)
+            for (j = 1; j < dim - 1; j++)
+                cur[(long) k * dim * dim + j] = problem->min_temp
+                    + (problem->max_temp - problem->min_temp) * rand_r (&seed)/(float)RAND_MAX;
+        memcpy (next, cur, sizeof (float) * stencil_points (dim));
+
+        int num_iter = 0;
+        for (;;) {
+            double diff = 0.0;
+            for (line = 0; line < num_lines; line++)
+                diff += jacobi_row (cur, next, dim, stencil_line (line, dim), 1, dim - 1);
+            num_iter++;
+
+            float *tmp = cur;
+            cur = next;
+            next = tmp;
+            if (diff/((double) num_lines * (dim - 2)) < eps)
+                break;
+            if (max_iter_multi > 0 && num_iter >= max_iter_multi)
+                break;
+        }
+
+        clock_gettime (CLOCK_MONOTONIC, &stop);
+        problem->num_iter = num_iter;
+        problem->time = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec)/1e9;
+        problem->thread = args_for_me->tid;
+    }
+
+    free ((void *) cur);
+    free ((void *) next);
+    return NULL;
+}
+
+/*------------------------------------------------------------------
+ * Function:    solve_batch
+ * Purpose:     Run --batch: solve the problems listed in path with
+ *              num_threads workers, print the iterations of every problem
+ *              and the throughput of the batch
+ *
+ * Input args:  path, num_threads
+ * Return val:  none
+ */  /*  */
+void
+solve_batch (const char *path, int num_threads)
+{
+    struct timeval start, stop;
+    int num_problems, i;
+
+    BATCH_PROBLEM_t *problems = read_batch (path, &num_problems);
+    if (problems == NULL)
+        exit (EXIT_FAILURE);
+    if (num_problems == 0) {
+        printf ("%s lists no problems\n", path);
+        exit (EXIT_FAILURE);
+    }
+    if (num_threads < 1)
+        num_threads = 1;
+
+    printf ("\nUsing %d threads to solve %d grids from %s, one grid per thread at a time\n", num_threads, num_problems, path);
+    gettimeofday (&start, NULL); /* Start timer */
+    compute_batch (problems, num_problems, num_threads);
+    gettimeofday (&stop, NULL); /* End timer */
+    double time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
+
+    double updates = 0.0;
+    int *solved_by = (int *) calloc (num_threads, sizeof (int));
+    printf ("%7s %6s %10s %10s %10s %12s %7s\n", "problem", "dim", "min-temp", "max-temp", "iterations", "time (s)", "thread");
+    for (i = 0; i < num_problems; i++) {
+        BATCH_PROBLEM_t *problem = &problems[i];
+        printf ("%7d %6d %10f %10f %10d %12f %7d\n", i, problem->dim, problem->min_temp, problem->max_temp,
+                problem->num_iter, problem->time, problem->thread);
+        updates += (double) stencil_lines (problem->dim) * (problem->dim - 2) * problem->num_iter;
+        solved_by[problem->thread]++;
+    }
+
+    int fewest = solved_by[0], most = solved_by[0];
+    for (i = 1; i < num_threads; i++) {
+        if (solved_by[i] < fewest)
+            fewest = solved_by[i];
+        if (solved_by[i] > most)
+            most = solved_by[i];
+    }
+    printf ("\nSolved %d grids using %d threads in: %fs\n", num_problems, num_threads, time_taken);
+    printf ("Problems per second: %f\n", num_problems/time_taken);
+    printf ("Effective lattice updates per second: %e\n", updates/time_taken);
+    printf ("Grids per thread: %d to %d\n", fewest, most);
+
+    free ((void *) solved_by);
+    free ((void *) problems);
+}
@@ -0,0 +1,433 @@
+/* Benchmark for the threaded Jacobi solvers.
+ *
+ * Runs compute_using_pthreads_jacobi_pool (or compute_using_pthreads_jacobi)
+ * for a fixed number of iterations over a list of grid sizes and thread
+ * counts, repeats every run, and reports the min and median time, the lattice
+ * update rate in GLUP/s and the memory bandwidth that rate implies. The
+ * bandwidth is compared with a STREAM-like triad measured on the same
+ * threads at startup.
+ *
+ * Strong scaling keeps each grid size fixed while the thread count grows.
+ * Weak scaling grows the grid with the thread count so every thread keeps
+ * the same number of points: dim = size * sqrt(threads / first thread count).
+ *
+ * Results also go to prefix.csv and prefix.json for regression tracking.
+ *
+ * Compile as follows:
+ * gcc -o bench bench.c jacobi.c kernels.c numa.c checkpoint.c profile.c stencil.c snapshot.c -O3 -Wall -std=c99 -lm -lpthread
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "grid.h"
+
+#define BENCH_ITER 100          /* Iterations per run */
+#define BENCH_REPEAT 5          /* Timed runs per configuration, after one warm-up run */
+#define BYTES_PER_UPDATE 8      /* One float read and one written per point, the neighbours come from cache */
+#define STREAM_MIN_MB 64        /* Triad arrays are 4x the last level cache, within these bounds */
+#define STREAM_MAX_MB 256
+#define MAX_LIST 32
+
+/* One benchmarked configuration */
+typedef struct bench_result_s {
+    const char *scaling;    /* "strong" or "weak" */
+    int dim;
+    int num_threads;
+    int num_iter;           /* Iterations of the last run, fewer than asked if it converged */
+    double min_time;
+    double median_time;
+    double glups;           /* Giga lattice updates per second, from min_time */
+    double gbytes;          /* Implied bandwidth in GB/s */
+} BENCH_RESULT_t;
+
+/* Structure that holds the arguments for the triad threads */
+typedef struct triad_args_s {
+    int tid;
+    int num_threads;
+    long n;
+    float *a, *b, *c;
+    pthread_barrier_t *barrier;
+    double *time;           /* Best time over the repeats, set by thread 0 */
+} TRIAD_ARGS_t;
+
+double stream_triad (int, long);
+void * triad_worker (void *);
+void bench_run (BENCH_RESULT_t *, int, int, int, int, int);
+int parse_list (char *, int *);
+double now (void);
+int compare_doubles (const void *, const void *);
+void write_results (const char *, BENCH_RESULT_t *, int, double, const char *);
+void print_usage (char *);
+
+int
+main (int argc, char **argv)
+{
+    int sizes[MAX_LIST] = {256, 512, 1024, 2048};
+    int threads[MAX_LIST];
+    int num_sizes = 4, num_counts = 0;
+    int num_iter = BENCH_ITER;
+    int repeat = BENCH_REPEAT;
+    int pool = 1;
+    int weak = 1, strong = 1;
+    char *kernel = "auto";
+    char *prefix = "bench";
+    int opt, s, t;
+
+    while ((opt = getopt (argc, argv, "n:t:i:r:s:d:k:m:o:")) != -1) {
+        switch (opt) {
+            case 'n':
+                num_sizes = parse_list (optarg, sizes);
+                break;
+            case 't':
+                num_counts = parse_list (optarg, threads);
+                break;
+            case 'i':
+                num_iter = atoi (optarg);
+                break;
+            case 'r':
+                repeat = atoi (optarg);
+                break;
+            case 's':
+                if (strcmp (optarg, "pool") == 0)
+                    pool = 1;
+                else if (strcmp (optarg, "jacobi") == 0)
+                    pool = 0;
+                else
+                    print_usage (argv[0]);
+                break;
+            case 'd':
+                if (strcmp (optarg, "cyclic") == 0)
+                    decomposition = DECOMP_CYCLIC;
+                else if (strcmp (optarg, "block") == 0)
+                    decomposition = DECOMP_BLOCK;
+                else
+                    print_usage (argv[0]);
+                break;
+            case 'k':
+                kernel = optarg;
+                break;
+            case 'm':
+                strong = (strcmp (optarg, "weak") != 0);
+                weak = (strcmp (optarg, "strong") != 0);
+                break;
+            case 'o':
+                prefix = optarg;
+                break;
+            default:
+                print_usage (argv[0]);
+        }
+    }
+    if (num_sizes <= 0 || num_counts < 0 || num_iter < 1 || repeat < 1)
+        print_usage (argv[0]);
+
+    /* default thread counts: 2, 4, ... up to the number of CPUs; the jacobi solvers need at least 2 */
+    if (num_counts == 0) {
+        long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+        for (t = 2; num_counts < MAX_LIST; t *= 2) {
+            threads[num_counts++] = t;
+            if (t >= cpus)
+                break;
+        }
+    }
+    for (t = 0; t < num_counts; t++) {
+        if (threads[t] < 2) {
+            printf ("The jacobi solvers need at least 2 threads\n");
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    if (select_stencil_kernel (kernel) != 0) {
+        printf ("Stencil kernel %s is unknown or not supported by this CPU\n", kernel);
+        exit (EXIT_FAILURE);
+    }
+
+    /* the triad runs on as many threads as the largest run */
+    int max_threads = threads[0];
+    for (t = 1; t < num_counts; t++)
+        if (threads[t] > max_threads)
+            max_threads = threads[t];
+    long llc = sysconf (_SC_LEVEL3_CACHE_SIZE);
+    long mb = (llc > 0) ? 4 * llc / (1 << 20) : STREAM_MIN_MB;
+    if (mb < STREAM_MIN_MB)
+        mb = STREAM_MIN_MB;
+    if (mb > STREAM_MAX_MB)
+        mb = STREAM_MAX_MB;
+    double stream = stream_triad (max_threads, mb * (1 << 20) / sizeof (float));
+
+    printf ("Solver: %s, %s decomposition, %s kernel, %d iterations, best and median of %d runs\n",
+            pool ? "pool" : "jacobi", (decomposition == DECOMP_BLOCK) ? "block" : "cyclic",
+            kernel_name, num_iter, repeat);
+    printf ("STREAM-like triad on %d threads, %ld MB arrays: %.2f GB/s\n", max_threads, mb, stream);
+    printf ("Bandwidth assumes %d bytes per lattice update\n\n", BYTES_PER_UPDATE);
+    printf ("%-7s %7s %8s %6s %12s %12s %9s %9s %8s\n", "scaling", "dim", "threads", "iter",
+            "min (s)", "median (s)", "GLUP/s", "GB/s", "%STREAM");
+
+    BENCH_RESULT_t *results = (BENCH_RESULT_t *) malloc (2 * MAX_LIST * MAX_LIST * sizeof (BENCH_RESULT_t));
+    int num_results = 0;
+    for (int mode = 0; mode < 2; mode++) {
+        if ((mode == 0 && !strong) || (mode == 1 && !weak))
+            continue;
+        for (s = 0; s < num_sizes; s++) {
+            for (t = 0; t < num_counts; t++) {
+                BENCH_RESULT_t *r = &results[num_results++];
+                int dim = sizes[s];
+                if (mode == 1)
+                    dim = (int) lround (sizes[s] * sqrt ((double) threads[t] / threads[0]));
+                r->scaling = (mode == 0) ? "strong" : "weak";
+                bench_run (r, dim, threads[t], num_iter, repeat, pool);
+                printf ("%-7s %7d %8d %6d %12f %12f %9.3f %9.2f %7.1f%%\n", r->scaling, r->dim, r->num_threads,
+                        r->num_iter, r->min_time, r->median_time, r->glups, r->gbytes, 100.0 * r->gbytes/stream);
+            }
+        }
+    }
+
+    write_results (prefix, results, num_results, stream, pool ? "pool" : "jacobi");
+    free ((void *) results);
+    exit (EXIT_SUCCESS);
+}
+
+/*------------------------------------------------------------------
+ * Function:    bench_run
+ * Purpose:     Time num_iter iterations of the jacobi solver on a dim x dim
+ *              grid, once to warm up and repeat times for the record
+ *
+ * Input args:  dim, num_threads, num_iter, repeat, pool
+ * Output args: r
+ * Return val:  none
+ */  /*  */
+void
+bench_run (BENCH_RESULT_t *r, int dim, int num_threads, int num_iter, int repeat, int pool)
+{
+    grid_t grid_0, grid_1;
+    size_t size = sizeof (float) * (size_t) dim * dim;
+    double *times = (double *) malloc (repeat * sizeof (double));
+    int k, j;
+
+    grid_0.dim = grid_1.dim = dim;
+    grid_0.element = (float *) malloc (size);
+    grid_1.element = (float *) malloc (size);
+    if (times == NULL || grid_0.element == NULL || grid_1.element == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    grid_multi_0 = &grid_0;
+    grid_multi_1 = &grid_1;
+    max_iter_multi = num_iter;
+
+    for (k = -1; k < repeat; k++) {
+        /* same plate every run: a north edge heated from 0 to 100 */
+        memset (grid_0.element, 0, size);
+        for (j = 1; j < dim - 1; j++)
+            grid_0.element[j] = 100.0 * j/(dim - 1);
+        memcpy (grid_1.element, grid_0.element, size);
+
+        double start = now ();
+        if (pool)
+            compute_using_pthreads_jacobi_pool (&grid_0, num_threads);
+        else
+            compute_using_pthreads_jacobi (&grid_0, num_threads);
+        double time_taken = now () - start;
+        if (k >= 0)
+            times[k] = time_taken;
+    }
+
+    qsort (times, repeat, sizeof (double), compare_doubles);
+    r->dim = dim;
+    r->num_threads = num_threads;
+    r->num_iter = num_iter_multi;
+    r->min_time = times[0];
+    r->median_time = (repeat % 2 == 1) ? times[repeat / 2] : 0.5 * (times[repeat / 2 - 1] + times[repeat / 2]);
+    r->glups = (double) (dim - 2) * (dim - 2) * num_iter_multi/r->min_time/1e9;
+    r->gbytes = r->glups * BYTES_PER_UPDATE;
+
+    free ((void *) times);
+    free ((void *) grid_0.element);
+    free ((void *) grid_1.element);
+}
+
+/*------------------------------------------------------------------
+ * Function:    stream_triad
+ * Purpose:     Measure a[i] = b[i] + s * c[i] over n floats per array with
+ *              num_threads threads, as STREAM does, and return the best
+ *              bandwidth over a few runs
+ *
+ * Input args:  num_threads, n
+ * Return val:  GB/s, counting 3 arrays of n floats per run
+ */  /*  */
+double
+stream_triad (int num_threads, long n)
+{
+    pthread_barrier_t barrier;
+    double best = INFINITY;
+    int i;
+
+    float *a = (float *) malloc (n * sizeof (float));
+    float *b = (float *) malloc (n * sizeof (float));
+    float *c = (float *) malloc (n * sizeof (float));
+    pthread_t *worker_thread = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+    TRIAD_ARGS_t *args_for_thread = (TRIAD_ARGS_t *) malloc (num_threads * sizeof (TRIAD_ARGS_t));
+    if (a == NULL || b == NULL || c == NULL || worker_thread == NULL || args_for_thread == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    pthread_barrier_init (&barrier, NULL, num_threads);
+    for (i = 0; i < num_threads; i++) {
+        args_for_thread[i].tid = i;
+        args_for_thread[i].num_threads = num_threads;
+        args_for_thread[i].n = n;
+        args_for_thread[i].a = a;
+        args_for_thread[i].b = b;
+        args_for_thread[i].c = c;
+        args_for_thread[i].barrier = &barrier;
+        args_for_thread[i].time = &best;
+
+        if ((create_solver_thread (&worker_thread[i], i, num_threads, triad_worker, (void *)&args_for_thread[i])) != 0) {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < num_threads; i++)
+        pthread_join (worker_thread[i], NULL);
+
+    pthread_barrier_destroy (&barrier);
+    free ((void *) a);
+    free ((void *) b);
+    free ((void *) c);
+    free ((void *) worker_thread);
+    free ((void *) args_for_thread);
+    return 3.0 * n * sizeof (float)/best/1e9;
+}
+
+/* Body of a triad thread: first-touch its part of the arrays, then run the
+ * triad over it ten times, timed between barriers by thread 0. */
+void *
+triad_worker (void *this_arg)
+{
+    TRIAD_ARGS_t *args_for_me = (TRIAD_ARGS_t *) this_arg;
+    long start = args_for_me->tid * args_for_me->n / args_for_me->num_threads;
+    long end = (args_for_me->tid + 1) * args_for_me->n / args_for_me->num_threads;
+    float *a = args_for_me->a, *b = args_for_me->b, *c = args_for_me->c;
+    const float scalar = 3.0f;
+    long i;
+    int k;
+
+    for (i = start; i < end; i++) {
+        a[i] = 0.0f;
+        b[i] = 1.0f;
+        c[i] = 2.0f;
+    }
+    for (k = 0; k < 10; k++) {
+        pthread_barrier_wait (args_for_me->barrier);
+        double t = now ();
+        for (i = start; i < end; i++)
+            a[i] = b[i] + scalar * c[i];
+        pthread_barrier_wait (args_for_me->barrier);
+        t = now () - t;
+        if (args_for_me->tid == 0 && t < *args_for_me->time)
+            *args_for_me->time = t;
+    }
+    return NULL;
+}
+
+/*------------------------------------------------------------------
+ * Function:    write_results
+ * Purpose:     Write the results to prefix.csv and prefix.json
+ *
+ * Input args:  prefix, results, num_results, stream (GB/s), solver
+ * Return val:  none
+ */  /*  */
+void
+write_results (const char *prefix, BENCH_RESULT_t *results, int num_results, double stream, const char *solver)
+{
+    char path[FILENAME_MAX];
+    int k;
+
+    snprintf (path, sizeof (path), "%s.csv", prefix);
+    FILE *csv = fopen (path, "w");
+    if (csv == NULL) {
+        perror (path);
+        return;
+    }
+    fprintf (csv, "solver,kernel,scaling,dim,threads,iterations,min_s,median_s,glups,gbytes_s,stream_gbytes_s\n");
+    for (k = 0; k < num_results; k++) {
+        BENCH_RESULT_t *r = &results[k];
+        fprintf (csv, "%s,%s,%s,%d,%d,%d,%.6f,%.6f,%.6f,%.6f,%.6f\n", solver, kernel_name, r->scaling, r->dim,
+                 r->num_threads, r->num_iter, r->min_time, r->median_time, r->glups, r->gbytes, stream);
+    }
+    fclose (csv);
+
+    snprintf (path, sizeof (path), "%s.json", prefix);
+    FILE *json = fopen (path, "w");
+    if (json == NULL) {
+        perror (path);
+        return;
+    }
+    fprintf (json, "{\n  \"solver\": \"%s\",\n  \"kernel\": \"%s\",\n  \"bytes_per_update\": %d,\n", solver, kernel_name, BYTES_PER_UPDATE);
+    fprintf (json, "  \"stream_gbytes_s\": %.6f,\n  \"results\": [\n", stream);
+    for (k = 0; k < num_results; k++) {
+        BENCH_RESULT_t *r = &results[k];
+        fprintf (json, "    {\"scaling\": \"%s\", \"dim\": %d, \"threads\": %d, \"iterations\": %d, "
+                 "\"min_s\": %.6f, \"median_s\": %.6f, \"glups\": %.6f, \"gbytes_s\": %.6f}%s\n",
+                 r->scaling, r->dim, r->num_threads, r->num_iter, r->min_time, r->median_time,
+                 r->glups, r->gbytes, (k < num_results - 1) ? "," : "");
+    }
+    fprintf (json, "  ]\n}\n");
+    fclose (json);
+    printf ("\nResults written to %s.csv and %s.json\n", prefix, prefix);
+}
+
+/* Parse a comma separated list of at most MAX_LIST positive integers. */
+int
+parse_list (char *arg, int *list)
+{
+    int n = 0;
+    char *token = strtok (arg, ",");
+
+    while (token != NULL && n < MAX_LIST) {
+        if ((list[n++] = atoi (token)) <= 0)
+            return -1;
+        token = strtok (NULL, ",");
+    }
+    return n;
+}
+
+/* Wall clock in seconds. */
+double
+now (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+int
+compare_doubles (const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* Print how to run the benchmark and exit. */
+void
+print_usage (char *name)
+{
+    printf ("Usage: %s [-n sizes] [-t threads] [-i iterations] [-r repeats] [-s solver] [-d decomposition] [-k kernel] [-m mode] [-o prefix]\n", name);
+    printf ("-n sizes: comma separated grid dimensions (default 256,512,1024,2048)\n");
+    printf ("-t threads: comma separated thread counts, at least 2 (default 2, 4, ... up to the number of CPUs)\n");
+    printf ("-i iterations: iterations per run (default %d)\n", BENCH_ITER);
+    printf ("-r repeats: timed runs per configuration after one warm-up (default %d)\n", BENCH_REPEAT);
+    printf ("-s solver: pool (default) or jacobi\n");
+    printf ("-d decomposition: cyclic (default) or block\n");
+    printf ("-k kernel: stencil kernel, auto (default), scalar, sse, avx2, avx512 or generated\n");
+    printf ("-m mode: strong, weak or both (default)\n");
+    printf ("-o prefix: write prefix.csv and prefix.json (default bench)\n");
+    exit (EXIT_FAILURE);
+}
@@ -0,0 +1,265 @@
+/* Checkpoint and restart for the Jacobi solvers.
+ *
+ * A checkpoint file is a CKPT_HEADER_SIZE byte header (magic, version, dim,
+ * iterations done, last diff) followed by the dim x dim floats of the newest
+ * grid, in the byte order of the machine that wrote it.
+ *
+ * checkpoint_post is called by the serial thread between sweeps. It only
+ * copies the grid into a snapshot buffer and wakes the writer thread, which
+ * writes the file in the background while the team keeps sweeping. If the
+ * writer is still busy with the previous checkpoint the new one is skipped
+ * rather than stalling the solve. Files are written to path.tmp and renamed
+ * over path, so a crash while writing leaves the previous checkpoint intact.
+ *
+ * checkpoint_map maps a checkpoint read-only for --resume.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "grid.h"
+
+#define CKPT_MAGIC "JACOBICK"
+#define CKPT_VERSION 1
+#define CKPT_HEADER_SIZE 64     /* Keeps the grid that follows aligned */
+
+/* What a checkpoint file starts with, padded to CKPT_HEADER_SIZE */
+typedef struct ckpt_header_s {
+    char magic[8];
+    int version;
+    int dim;
+    int num_iter;           /* Iterations done when the grid was taken */
+    int reserved;
+    double diff;            /* Diff of the last of them */
+} CKPT_HEADER_t;
+
+int checkpoint_every = 0;               /* Iterations between checkpoints, 0 = off */
+
+static char *ckpt_path;
+static char *ckpt_tmp_path;
+static float *snapshot;                 /* Grid being written, owned by the writer while busy */
+static CKPT_HEADER_t snapshot_header;
+static int writer_busy, writer_quit;
+static int last_posted, num_written, num_skipped;
+static pthread_t writer_thread;
+static pthread_mutex_t ckpt_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ckpt_cond = PTHREAD_COND_INITIALIZER;
+
+void * checkpoint_writer (void *);
+
+/*------------------------------------------------------------------
+ * Function:    checkpoint_start
+ * Purpose:     Start the writer thread that saves a dim x dim grid to path
+ *              every checkpoint_every iterations
+ *
+ * Input args:  path, dim, num_iter (iterations already done)
+ * Return val:  none
+ */  /*  */
+void
+checkpoint_start (const char *path, int dim, int num_iter)
+{
+    ckpt_path = strdup (path);
+    ckpt_tmp_path = (char *) malloc (strlen (path) + 5);
+    snapshot = (float *) malloc (sizeof (float) * (size_t) dim * dim);
+    if (ckpt_path == NULL || ckpt_tmp_path == NULL || snapshot == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    sprintf (ckpt_tmp_path, "%s.tmp", path);
+
+    memset (&snapshot_header, 0, sizeof (snapshot_header));
+    memcpy (snapshot_header.magic, CKPT_MAGIC, 8);
+    snapshot_header.version = CKPT_VERSION;
+    snapshot_header.dim = dim;
+    last_posted = num_iter;
+    writer_busy = writer_quit = 0;
+    num_written = num_skipped = 0;
+
+    if ((pthread_create (&writer_thread, NULL, checkpoint_writer, NULL)) != 0) {
+        perror ("pthread_create");
+        exit (EXIT_FAILURE);
+    }
+}
+
+/*------------------------------------------------------------------
+ * Function:    checkpoint_post
+ * Purpose:     Hand the grid after num_iter iterations to the writer if a
+ *              checkpoint is due. Must be called while no thread writes the
+ *              grid; it returns as soon as the grid is copied
+ *
+ * Input args:  grid, num_iter, diff
+ * Return val:  none
+ */  /*  */
+void
+checkpoint_post (const grid_t *grid, int num_iter, double diff)
+{
+    if (checkpoint_every <= 0 || num_iter - last_posted < checkpoint_every)
+        return;
+    last_posted = num_iter;
+
+    pthread_mutex_lock (&ckpt_mutex);
+    if (writer_busy) {
+        num_skipped++;
+        pthread_mutex_unlock (&ckpt_mutex);
+        return;
+    }
+    pthread_mutex_unlock (&ckpt_mutex);
+
+    /* the writer is idle, so the snapshot is ours until it is signalled */
+    memcpy (snapshot, grid->element, sizeof (float) * (size_t) grid->dim * grid->dim);
+    snapshot_header.num_iter = num_iter;
+    snapshot_header.diff = diff;
+
+    pthread_mutex_lock (&ckpt_mutex);
+    writer_busy = 1;
+    pthread_cond_signal (&ckpt_cond);
+    pthread_mutex_unlock (&ckpt_mutex);
+}
+
+/* Wait for the checkpoint being written, stop the writer and report. */
+void
+checkpoint_stop (void)
+{
+    pthread_mutex_lock (&ckpt_mutex);
+    writer_quit = 1;
+    pthread_cond_signal (&ckpt_cond);
+    pthread_mutex_unlock (&ckpt_mutex);
+    pthread_join (writer_thread, NULL);
+
+    printf ("Wrote %d checkpoint(s) to %s, skipped %d while the writer was busy\n", num_written, ckpt_path, num_skipped);
+    free ((void *) snapshot);
+    free ((void *) ckpt_path);
+    free ((void *) ckpt_tmp_path);
+}
+
+/* Write all of buf to fd. */
+static int
+write_all (int fd, const void *buf, size_t size)
+{
+    const char *p = (const char *) buf;
+
+    while (size > 0) {
+        ssize_t n = write (fd, p, size);
+        if (n < 0)
+            return -1;
+        p += n;
+        size -= n;
+    }
+    return 0;
+}
+
+/*------------------------------------------------------------------
+ * Function:    checkpoint_writer
+ * Purpose:     Body of the writer thread: wait for a snapshot, write it to
+ *              the temporary file, flush it and rename it over the checkpoint
+ *
+ * Input args:  unused
+ * Return val:  NULL
+ */  /*  */
+void *
+checkpoint_writer (void *unused)
+{
+    char header[CKPT_HEADER_SIZE];
+
+    for (;;) {
+        pthread_mutex_lock (&ckpt_mutex);
+        while (!writer_busy && !writer_quit)
+            pthread_cond_wait (&ckpt_cond, &ckpt_mutex);
+        if (!writer_busy) {
+            pthread_mutex_unlock (&ckpt_mutex);
+            return NULL;
+        }
+        pthread_mutex_unlock (&ckpt_mutex);
+
+        memset (header, 0, sizeof (header));
+        memcpy (header, &snapshot_header, sizeof (snapshot_header));
+        size_t size = sizeof (float) * (size_t) snapshot_header.dim * snapshot_header.dim;
+
+        /* fd is closed exactly once: another thread may be handed its number as soon as it is */
+        int status = -1;
+        int fd = open (ckpt_tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            status = (write_all (fd, header, sizeof (header)) == 0 && write_all (fd, snapshot, size) == 0
+                      && fsync (fd) == 0) ? 0 : -1;
+            if (close (fd) != 0)
+                status = -1;
+        }
+        if (status != 0 || rename (ckpt_tmp_path, ckpt_path) != 0)
+            perror (ckpt_tmp_path);
+        else
+            num_written++;
+
+        pthread_mutex_lock (&ckpt_mutex);
+        writer_busy = 0;
+        pthread_mutex_unlock (&ckpt_mutex);
+    }
+}
+
+/*------------------------------------------------------------------
+ * Function:    checkpoint_map
+ * Purpose:     Map a checkpoint file read-only and check its header
+ *
+ * Input args:  path
+ * Output args: num_iter, diff
+ * Return val:  grid pointing into the mapping, NULL if the file is not a
+ *              valid checkpoint
+ */  /*  */
+grid_t *
+checkpoint_map (const char *path, int *num_iter, double *diff)
+{
+    struct stat st;
+    CKPT_HEADER_t header;
+
+    int fd = open (path, O_RDONLY);
+    if (fd < 0) {
+        perror (path);
+        return NULL;
+    }
+    if (fstat (fd, &st) != 0 || st.st_size < CKPT_HEADER_SIZE) {
+        printf ("%s is not a checkpoint\n", path);
+        close (fd);
+        return NULL;
+    }
+    char *base = (char *) mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (base == MAP_FAILED) {
+        perror ("mmap");
+        return NULL;
+    }
+
+    memcpy (&header, base, sizeof (header));
+    if (memcmp (header.magic, CKPT_MAGIC, 8) != 0 || header.version != CKPT_VERSION || header.dim < 3
+        || st.st_size != CKPT_HEADER_SIZE + (off_t) sizeof (float) * header.dim * header.dim) {
+        printf ("%s is not a version %d checkpoint or is truncated\n", path, CKPT_VERSION);
+        munmap (base, st.st_size);
+        return NULL;
+    }
+    madvise (base, st.st_size, MADV_SEQUENTIAL);
+
+    grid_t *grid = (grid_t *) malloc (sizeof (grid_t));
+    if (grid == NULL)
+        return NULL;
+    grid->dim = header.dim;
+    grid->element = (float *) (base + CKPT_HEADER_SIZE);
+    *num_iter = header.num_iter;
+    *diff = header.diff;
+    return grid;
+}
+
+/* Unmap a grid returned by checkpoint_map. */
+void
+checkpoint_unmap (grid_t *grid)
+{
+    munmap ((char *) grid->element - CKPT_HEADER_SIZE,
+            CKPT_HEADER_SIZE + sizeof (float) * (size_t) grid->dim * grid->dim);
+    free ((void *) grid);
+}
@@ -3,18 +3,61 @@
 #include <math.h>
 #include "grid.h"
 
-/* This function solves the Gauss-Seidel method on the CPU using a single thread. */
+#define GOLD_EPS 1e-2           /* Convergence criteria of the single-threaded solvers. */
+#define PI 3.14159265358979323846
+#define ADAPT_TOLERANCE 1e-3    /* Rate change below which the rate is taken as settled */
+#define ADAPT_MIN_ITER 20       /* Let the transient of a new omega die out before measuring the rate */
+#define ADAPT_MAX_ITER 200      /* Give up waiting for the rate to settle after this many iterations */
+
+/* This function solves the Gauss-Seidel method on the CPU using a single thread, with the stencil of stencil.c in use. */
 int 
 compute_gold (grid_t *grid)
 {
     int num_iter = 0;
 	int done = 0;
-    int i, j;
 	double diff;
-	float old, new; 
-    float eps = 1e-2; /* Convergence criteria. */
-    int num_elements; 
+    float eps = GOLD_EPS; /* Convergence criteria. */
+    long num_elements; 
+    long n, num_lines = stencil_lines (grid->dim);
+	
+	while(!done) { /* While we have not converged yet. */
+        diff = 0.0;
+        num_elements = 0;
+
+        /* Apply the update rule of the stencil in place, line by line (row by row in 2-D). */
+        for (n = 0; n < num_lines; n++) {
+            diff = stencil->gold_line (grid->element, grid->dim, stencil_line (n, grid->dim), diff);
+            num_elements += grid->dim - 2;
+        }
+		
+        /* End of an iteration. Check for convergence. */
+        diff = diff/num_elements;
+        printf ("Iteration %d. DIFF: %f.\n", num_iter, diff);
+        num_iter++;
+			  
+        if (diff < eps) 
+            done = 1;
+	}
 	
+    return num_iter;
+}
+
+/* This function solves the grid with successive over-relaxation on the CPU using a single thread.
+ * Every point moves omega times as far as Gauss-Seidel would move it. With omega = OMEGA_ADAPT
+ * the sweeps start as plain Gauss-Seidel and omega is raised from the observed rate, see sor_adapt. */
+int
+compute_gold_sor (grid_t *grid, float omega)
+{
+    int num_iter = 0;
+	int done = 0;
+    int i, j;
+	double diff;
+	float old, new;
+    float eps = GOLD_EPS; /* Convergence criteria. */
+    int num_elements;
+    SOR_ADAPT_t adapt = {0.0, 0.0, 0.0, 0};
+    float w = (omega == OMEGA_ADAPT) ? 1.0 : omega;
+
 	while(!done) { /* While we have not converged yet. */
         diff = 0.0;
         num_elements = 0;
@@ -22,27 +65,74 @@ compute_gold (grid_t *grid)
         for (i = 1; i < (grid->dim - 1); i++) {
             for (j = 1; j < (grid->dim - 1); j++) {
                 old = grid->element[i * grid->dim + j]; /* Store old value of grid point. */
-                /* Apply the update rule. */	
-                new = 0.25 * (grid->element[(i - 1) * grid->dim + j] +\
-                              grid->element[(i + 1) * grid->dim + j] +\
-                              grid->element[i * grid->dim + (j + 1)] +\
-                              grid->element[i * grid->dim + (j - 1)]);
+                /* Apply the update rule, over-relaxed. Done in double, or the amplified
+                 * rounding error keeps diff from settling. */
+                new = old + w * (0.25 * ((double) grid->element[(i - 1) * grid->dim + j] +\
+                                         grid->element[(i + 1) * grid->dim + j] +\
+                                         grid->element[i * grid->dim + (j + 1)] +\
+                                         grid->element[i * grid->dim + (j - 1)]) - old);
 
                 grid->element[i * grid->dim + j] = new; /* Update the grid-point value. */
                 diff = diff + fabs(new - old); /* Calculate the difference in values. */
                 num_elements++;
             }
         }
-		
+
         /* End of an iteration. Check for convergence. */
         diff = diff/num_elements;
-        printf ("Iteration %d. DIFF: %f.\n", num_iter, diff);
+        printf ("Iteration %d. DIFF: %f. OMEGA: %f.\n", num_iter, diff, w);
         num_iter++;
-			  
-        if (diff < eps) 
+
+        if (omega == OMEGA_ADAPT) {
+            float estimate = sor_adapt (&adapt, diff, w);
+            if (estimate > 0.0)
+                w = estimate;
+        }
+
+        if (diff < eps)
             done = 1;
 	}
-	
+
     return num_iter;
 }
 
+/* Optimal SOR factor for the Laplace equation on a dim x dim grid with fixed boundaries,
+ * 2 / (1 + sin (pi h)) with h = 1 / (dim - 1). */
+float
+sor_omega (int dim)
+{
+    return 2.0/(1.0 + sin (PI/(dim - 1)));
+}
+
+/* Feed the diff of every iteration run with omega. Once the ratio of successive diffs settles it
+ * is taken as the spectral radius lambda of SOR with that omega. Young's relation
+ * (lambda + omega - 1)^2 = lambda omega^2 rho^2 gives the spectral radius rho of Jacobi, and
+ * 2 / (1 + sqrt (1 - rho^2)) the optimal omega. The estimate only ever grows, since lambda is
+ * only informative below the optimum, and the rate is only trusted once diff has fallen below
+ * where it was when omega last changed. Returns the new omega, or 0 while the rate is settling. */
+float
+sor_adapt (SOR_ADAPT_t *adapt, double diff, float omega)
+{
+    float new_omega = 0.0;
+
+    if (adapt->count > 0 && adapt->last_diff > 0.0) {
+        double rate = diff/adapt->last_diff;
+        if (adapt->count >= ADAPT_MIN_ITER && rate < 1.0 && diff < adapt->start_diff &&
+            (fabs (rate - adapt->last_rate) < ADAPT_TOLERANCE || adapt->count >= ADAPT_MAX_ITER)) {
+            double rho2 = (rate + omega - 1.0) * (rate + omega - 1.0)/(rate * omega * omega);
+            if (rho2 < 1.0) {
+                double estimate = 2.0/(1.0 + sqrt (1.0 - rho2));
+                /* step halfway, overshooting the optimum costs far more than undershooting */
+                if (estimate > omega + ADAPT_TOLERANCE)
+                    new_omega = omega + 0.5 * (estimate - omega);
+            }
+            adapt->count = 0;   /* wait for the rate under the new omega to settle */
+        }
+        adapt->last_rate = rate;
+    }
+    if (adapt->count == 0)
+        adapt->start_diff = diff;
+    adapt->last_diff = diff;
+    adapt->count++;
+    return new_omega;
+}
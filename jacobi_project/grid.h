@@ -1,9 +1,123 @@
 #ifndef __GRID__
 #define __GRID__
 
+#include <pthread.h>
+
 typedef struct grid_s {
 	int dim;  /* Dimension of the grid. */
 	float *element;
 } grid_t;
 
+/* How rows are handed out to the threads of the jacobi solvers, picked with the -d option */
+#define DECOMP_CYCLIC 0     /* thread tid gets rows tid+1, tid+1+num_threads, ... */
+#define DECOMP_BLOCK 1      /* thread tid gets one contiguous band of rows */
+
+#define TILE_WIDTH 1024     /* Default column tile for DECOMP_BLOCK: 3 rows of 4KB stay in L1/L2 */
+#define CHECK_ASYNC 0       /* check_interval value: test convergence one iteration behind */
+
+/* Storage of the grids in compute_using_lowprec_jacobi, arithmetic is always float */
+#define STORAGE_FP32 0
+#define STORAGE_BF16 1      /* bfloat16 */
+#define STORAGE_FP16 2      /* IEEE half */
+
+/* Value format of the snapshot files, see snapshot.c */
+#define SNAPSHOT_F32 0
+#define SNAPSHOT_BF16 1
+
+#define OMEGA_ADAPT -1.0    /* Ask the SOR solvers to pick omega from the observed convergence rate */
+
+/* State of the adaptive omega estimate, see sor_adapt */
+typedef struct sor_adapt_s {
+    double last_diff;
+    double last_rate;
+    double start_diff;      /* diff when omega last changed */
+    int count;              /* iterations since omega last changed */
+} SOR_ADAPT_t;
+
+/* A stencil of the stencil engine, see stencil.c */
+typedef struct stencil_s {
+    const char *name;
+    int ndim;               /* A grid holds dim^ndim floats */
+    int points;
+    double (*line) (const float *, float *, int, int, int, int);    /* Jacobi kernel, same as jacobi_row */
+    double (*gold_line) (float *, int, int, double);                /* In-place sweep of one line for compute_gold */
+} STENCIL_t;
+
+/* One grid of a --batch run, see batch.c */
+typedef struct batch_problem_s {
+    int dim;
+    float min_temp, max_temp;   /* Range of the random north side temperatures */
+    int num_iter;               /* Set by compute_batch */
+    double time;
+    int thread;                 /* Worker that solved it */
+} BATCH_PROBLEM_t;
+
+/* Shared between solver.c and the other solver engines */
+extern double (*jacobi_row) (const float *, float *, int, int, int, int);   /* kernels.c */
+extern const char *kernel_name;
+int select_kernel (const char *);
+grid_t * compute_using_wavefront_jacobi (grid_t *, grid_t *, int, int, int, int *);
+int compute_gold_sor (grid_t *, float);                                     /* gold_solver.c */
+float sor_omega (int);
+float sor_adapt (SOR_ADAPT_t *, double, float);
+grid_t * compute_using_redblack_gs (grid_t *, int, float, int *);
+grid_t * compute_using_multigrid (grid_t *, int, int, int *);
+extern const STENCIL_t *stencil;                                            /* stencil.c */
+int select_stencil (const char *);
+int select_stencil_kernel (const char *);
+long stencil_points (int);
+long stencil_lines (int);
+int stencil_line (long, int);
+extern int pin_threads;                                                     /* numa.c */
+extern int first_touch;
+int create_solver_thread (pthread_t *, int, int, void *(*) (void *), void *);
+grid_t * copy_grid_first_touch (grid_t *, int, int);
+void print_thread_layout (grid_t *, int, int);
+grid_t * map_grid (const char *, int);                                      /* ooc.c */
+void unmap_grid (grid_t *);
+grid_t * compute_using_ooc_jacobi (grid_t *, grid_t *, int, int, int *);
+extern int checkpoint_every;                                                /* checkpoint.c */
+void checkpoint_start (const char *, int, int);
+void checkpoint_post (const grid_t *, int, double);
+void checkpoint_stop (void);
+grid_t * checkpoint_map (const char *, int *, double *);
+void checkpoint_unmap (grid_t *);
+extern int snapshot_every;                                                  /* snapshot.c */
+void snapshot_start (const char *, int, int);
+void snapshot_post (const grid_t *, int, double);
+void snapshot_grid (const grid_t *, int, double);
+void snapshot_stop (void);
+grid_t * compute_using_processes (grid_t *, int, int *);                   /* mproc.c */
+void report_process_scaling (grid_t *, int);
+grid_t * compute_using_lowprec_jacobi (grid_t *, int, int, int *);        /* lowprec.c */
+int storage_supported (int);
+const char * storage_name (int);
+extern int profile_enabled;                                                 /* profile.c */
+void profile_start (int);
+void profile_thread_enter (int);
+void profile_thread_exit (int);
+void profile_compute_begin (int);
+void profile_compute_end (int, int);
+void profile_wait_end (int);
+void profile_stop (const char *);
+BATCH_PROBLEM_t * read_batch (const char *, int *);                         /* batch.c */
+void compute_batch (BATCH_PROBLEM_t *, int, int);
+void solve_batch (const char *, int);
+extern grid_t *grid_multi_0;                                                /* jacobi.c */
+extern grid_t *grid_multi_1;
+extern int num_iter_multi;
+extern int check_interval;
+extern int decomposition;
+extern int tile_width;
+extern int start_iter_multi;
+extern int max_iter_multi;
+grid_t * compute_using_pthreads_jacobi (grid_t *, int);
+grid_t * compute_using_pthreads_jacobi_pool (grid_t *, int);
+grid_t * compute_using_pthreads_jacobi_inplace (grid_t *, int);
+void log_diff (int, double);
+void print_diff_log (void);
+void clear_diff_log (void);
+grid_t * compute_warm_start (grid_t *, const float *, int, int *);         /* warm.c */
+void report_warm_start (grid_t *, int, float, float, int);
+
 #endif
@@ -0,0 +1,598 @@
+/* Threaded Jacobi solvers: threads created every iteration
+ * (compute_using_pthreads_jacobi) or a persistent pool meeting at a barrier
+ * (compute_using_pthreads_jacobi_pool). Both sweep grid_multi_0 and
+ * grid_multi_1 in turn with jacobi_row, line by line, so they solve grids
+ * of any of the stencils in stencil.c. The pool can also sweep one grid in
+ * place (compute_using_pthreads_jacobi_inplace). While profile_enabled is set the
+ * threads report their phases to profile.c.
+ *
+ * Kept apart from solver.c so bench.c can drive the same code.
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <math.h>
+#include "grid.h"
+
+#define CACHE_LINE 64       /* Per-thread accumulators are padded to this size */
+
+/* Structure that holds the arguments for thread function */
+typedef struct args_for_thread_s {
+    int tid;        /* Thread ID */
+    int num_iter;
+    int num_threads;
+    int one_shot;   /* Thread lives for this iteration only */
+} ARGS_FOR_THREAD_t;
+
+/* Partial diff of one thread, alone on its cache line so the threads never share one */
+typedef struct partial_diff_s {
+    double diff;
+    long num_elements;
+} __attribute__ ((aligned (CACHE_LINE))) PARTIAL_DIFF_t;
+
+/* One convergence test, kept until the solve is over instead of printed from the hot loop */
+typedef struct diff_log_s {
+    int num_iter;
+    double diff;
+} DIFF_LOG_t;
+
+void pthreads_solver(void*);
+void * pool_worker (void *);
+void * inplace_worker (void *);
+double reduce_diff (int, int);
+double record_verdict (int, int, float);
+
+/* Global variables for all threads */
+grid_t *grid_multi_0;
+grid_t *grid_multi_1;
+int num_iter_multi;
+PARTIAL_DIFF_t *partial_multi;      /* [2][num_threads]: slot num_iter % 2 is written by iteration num_iter */
+pthread_barrier_t barrier_multi;    /* Barrier the pool workers meet at after every sweep */
+int converged_multi;                /* Iteration that met eps, -1 until then */
+int check_interval = 1;             /* Test convergence every check_interval iterations, or CHECK_ASYNC */
+DIFF_LOG_t *diff_log;               /* Convergence tests of the last solve */
+int diff_log_len, diff_log_size;
+int decomposition = DECOMP_CYCLIC;  /* Row assignment used by pthreads_solver */
+int tile_width = TILE_WIDTH;        /* Columns per tile for DECOMP_BLOCK and SOLVER_WAVEFRONT, 0 sweeps whole rows */
+int start_iter_multi = 0;           /* Iterations already done by the grid a solve starts from (--resume) */
+int max_iter_multi = 0;             /* Stop after this many iterations even if not converged, 0 = no limit */
+float *halo_inplace;                /* [num_threads][2 sides][2 parities][dim]: band edges for the in-place solver */
+
+/*------------------------------------------------------------------
+ * Function:    compute_using_pthreads_jacobi
+ * Purpose:     Create threads and split the work evenly among them,
+ *              set input in args_for_thread stuct and call pthread solver
+ *              repead until convergence is at required amount
+ *              
+ * Input args:  *grid, num_threads
+ * Return val:  grid_t* 
+ */  /*  */
+grid_t * 
+compute_using_pthreads_jacobi (grid_t *grid, int num_threads)
+{
+    /* verify input arguments */
+    if (num_threads < 2){
+        printf("You only chose one thread, Multi-Thread can't be done!\n");
+        return 0;
+    }
+    int num_iter = start_iter_multi;
+	int done = 0;
+    float eps = 1e-6;
+    pthread_t *worker_thread = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+    ARGS_FOR_THREAD_t *args_for_thread = (ARGS_FOR_THREAD_t *) malloc (num_threads * sizeof (ARGS_FOR_THREAD_t));
+    partial_multi = (PARTIAL_DIFF_t *) aligned_alloc (CACHE_LINE, 2 * num_threads * sizeof (PARTIAL_DIFF_t));
+    diff_log_len = 0;
+
+    /* repeat until convergence is achieved */
+    while(!done){
+
+        /* load arguments into thread */
+        for (int i=0; i< num_threads; i++){
+            args_for_thread[i].tid = i;
+            args_for_thread[i].num_iter = num_iter;
+            args_for_thread[i].num_threads = num_threads;
+            args_for_thread[i].one_shot = 1;
+
+            /* create thread */
+            if ((create_solver_thread (&worker_thread[i], i, num_threads, (void *(*) (void *)) pthreads_solver, (void *)&args_for_thread[i])) != 0) {
+                perror ("pthread_create");
+                exit (EXIT_FAILURE);
+            }
+        }
+        /* wait for all threads to finish */
+        for (int i = 0; i < num_threads; i++){
+            pthread_join (worker_thread[i], NULL);
+        }
+        if (profile_enabled)
+            for (int i = 0; i < num_threads; i++)
+                profile_wait_end (i);
+        
+        /* test for convergence every check_interval iterations; the join already
+         * synchronizes, so an asynchronous check buys nothing here */
+        num_iter++;
+        if (check_interval == CHECK_ASYNC || num_iter % check_interval == 0) {
+            double test = reduce_diff (num_iter - 1, num_threads);
+            log_diff (num_iter, test);
+            if (test < eps) 
+                done = 1;
+            checkpoint_post ((num_iter % 2 == 1) ? grid_multi_0 : grid_multi_1, num_iter, test);
+            snapshot_post ((num_iter % 2 == 1) ? grid_multi_0 : grid_multi_1, num_iter, test);
+        }
+        if (max_iter_multi > 0 && num_iter >= max_iter_multi)
+            done = 1;
+    }
+    free ((void *) worker_thread);
+    free ((void *) args_for_thread);
+    free ((void *) partial_multi);
+
+    /* return newest grid value when convergence is achieved */
+    num_iter_multi = num_iter;
+    if (num_iter %2 == 1){
+        return grid_multi_0;
+    } else {
+        return grid_multi_1;
+    }
+}
+
+/*------------------------------------------------------------------
+ * Function:    compute_using_pthreads_jacobi_pool
+ * Purpose:     Same as compute_using_pthreads_jacobi, but the threads are
+ *              created once and stay alive until convergence. The workers
+ *              meet at a barrier after every sweep, the last one through
+ *              reduces the diff and decides if the team is done. See
+ *              pool_worker for check_interval
+ *              
+ * Input args:  *grid, num_threads
+ * Return val:  grid_t* 
+ */  /*  */
+grid_t * 
+compute_using_pthreads_jacobi_pool (grid_t *grid, int num_threads)
+{
+    /* verify input arguments */
+    if (num_threads < 2){
+        printf("You only chose one thread, Multi-Thread can't be done!\n");
+        return 0;
+    }
+    pthread_t *worker_thread = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+    ARGS_FOR_THREAD_t *args_for_thread = (ARGS_FOR_THREAD_t *) malloc (num_threads * sizeof (ARGS_FOR_THREAD_t));
+    partial_multi = (PARTIAL_DIFF_t *) aligned_alloc (CACHE_LINE, 2 * num_threads * sizeof (PARTIAL_DIFF_t));
+    diff_log_len = 0;
+    converged_multi = -1;
+    pthread_barrier_init (&barrier_multi, NULL, num_threads);
+
+    /* create the team once, every thread runs until convergence */
+    for (int i = 0; i < num_threads; i++){
+        args_for_thread[i].tid = i;
+        args_for_thread[i].num_iter = start_iter_multi;
+        args_for_thread[i].num_threads = num_threads;
+        args_for_thread[i].one_shot = 0;
+
+        if ((create_solver_thread (&worker_thread[i], i, num_threads, pool_worker, (void *)&args_for_thread[i])) != 0) {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < num_threads; i++){
+        pthread_join (worker_thread[i], NULL);
+    }
+
+    pthread_barrier_destroy (&barrier_multi);
+    free ((void *) worker_thread);
+    free ((void *) args_for_thread);
+    free ((void *) partial_multi);
+
+    /* return newest grid value when convergence is achieved */
+    if (num_iter_multi %2 == 1){
+        return grid_multi_0;
+    } else {
+        return grid_multi_1;
+    }
+}
+
+/*------------------------------------------------------------------
+ * Function:    pool_worker
+ * Purpose:     Body of a persistent thread. After every sweep the team meets
+ *              at the barrier so the grids can be swapped. Every
+ *              check_interval iterations the serial thread through the
+ *              barrier also reduces the partial diffs and the team waits
+ *              once more so everyone sees the verdict. With CHECK_ASYNC the
+ *              serial thread reduces iteration n while the others already
+ *              sweep n+1, the verdict is read at the barrier after n+1, and
+ *              the only cost is one extra sweep at the end
+ *              
+ * Input args:  this_arg (thread argument structure)
+ * Return val:  NULL
+ */  /*  */
+void *
+pool_worker (void *this_arg)
+{
+    ARGS_FOR_THREAD_t *args_for_me = (ARGS_FOR_THREAD_t *) this_arg;
+    float eps = 1e-6;
+    int lag = (check_interval == CHECK_ASYNC) ? 1 : 0;
+
+    if (profile_enabled)
+        profile_thread_enter (args_for_me->tid);
+    for (;;) {
+        int num_iter = args_for_me->num_iter;
+        int check = lag || (num_iter + 1) % check_interval == 0;
+        pthreads_solver (args_for_me);
+
+        if (pthread_barrier_wait (&barrier_multi) == PTHREAD_BARRIER_SERIAL_THREAD && check) {
+            double test = record_verdict (num_iter, args_for_me->num_threads, eps);
+            /* the grid iteration num_iter wrote is only read until the next barrier */
+            checkpoint_post ((num_iter % 2 == 0) ? grid_multi_0 : grid_multi_1, num_iter + 1, test);
+            snapshot_post ((num_iter % 2 == 0) ? grid_multi_0 : grid_multi_1, num_iter + 1, test);
+        }
+        if (check && !lag)
+            pthread_barrier_wait (&barrier_multi);
+        if (profile_enabled)
+            profile_wait_end (args_for_me->tid);
+
+        /* stop once the verdict on iteration num_iter - lag is in */
+        int converged = __atomic_load_n (&converged_multi, __ATOMIC_ACQUIRE);
+        if (converged >= 0 && converged <= num_iter - lag)
+            break;
+        if (max_iter_multi > 0 && num_iter + 1 >= max_iter_multi)
+            break;
+
+        /* read and write grids switch every iteration */
+        args_for_me->num_iter++;
+    }
+
+    if (profile_enabled)
+        profile_thread_exit (args_for_me->tid);
+    if (args_for_me->tid == 0)
+        num_iter_multi = args_for_me->num_iter + 1;
+    return NULL;
+}
+
+/*------------------------------------------------------------------
+ * Function:    compute_using_pthreads_jacobi_inplace
+ * Purpose:     Jacobi on grid alone, without a second grid. Each thread of a
+ *              pool owns a band of rows and overwrites it in place, keeping
+ *              the old values it still needs in a rolling window of three
+ *              rows. The old edge rows of the neighbouring bands come from
+ *              halo_inplace, where every thread leaves copies of its edge rows
+ *              after its sweep. Barriers and convergence tests are those of
+ *              compute_using_pthreads_jacobi_pool. 2-D stencils only. No
+ *              more threads than interior rows are started
+ *              
+ * Input args:  *grid, num_threads
+ * Return val:  grid_t* 
+ */  /*  */
+grid_t * 
+compute_using_pthreads_jacobi_inplace (grid_t *grid, int num_threads)
+{
+    /* verify input arguments */
+    if (num_threads < 2){
+        printf("You only chose one thread, Multi-Thread can't be done!\n");
+        return 0;
+    }
+    int dim = grid->dim;
+    /* a thread without rows would leave its halo slots unset for its neighbours */
+    if (num_threads > dim - 2)
+        num_threads = dim - 2;
+    pthread_t *worker_thread = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+    ARGS_FOR_THREAD_t *args_for_thread = (ARGS_FOR_THREAD_t *) malloc (num_threads * sizeof (ARGS_FOR_THREAD_t));
+    partial_multi = (PARTIAL_DIFF_t *) aligned_alloc (CACHE_LINE, 2 * num_threads * sizeof (PARTIAL_DIFF_t));
+    halo_inplace = (float *) malloc (sizeof (float) * 4 * num_threads * (size_t) dim);
+    if (worker_thread == NULL || args_for_thread == NULL || partial_multi == NULL || halo_inplace == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    grid_multi_0 = grid;
+    diff_log_len = 0;
+    converged_multi = -1;
+    pthread_barrier_init (&barrier_multi, NULL, num_threads);
+
+    for (int i = 0; i < num_threads; i++){
+        args_for_thread[i].tid = i;
+        args_for_thread[i].num_iter = start_iter_multi;
+        args_for_thread[i].num_threads = num_threads;
+        args_for_thread[i].one_shot = 0;
+
+        if ((create_solver_thread (&worker_thread[i], i, num_threads, inplace_worker, (void *)&args_for_thread[i])) != 0) {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < num_threads; i++){
+        pthread_join (worker_thread[i], NULL);
+    }
+
+    pthread_barrier_destroy (&barrier_multi);
+    free ((void *) worker_thread);
+    free ((void *) args_for_thread);
+    free ((void *) partial_multi);
+    free ((void *) halo_inplace);
+    return grid;
+}
+
+/* Halo slot of thread tid: side 0 is its first row, side 1 its last, as they were before iteration parity. */
+static float *
+inplace_halo (int tid, int side, int parity, int dim)
+{
+    return halo_inplace + (((long) tid * 2 + side) * 2 + parity) * dim;
+}
+
+/*------------------------------------------------------------------
+ * Function:    inplace_worker
+ * Purpose:     Body of a thread of compute_using_pthreads_jacobi_inplace.
+ *              The window holds each row twice, in slots r % 3 and
+ *              r % 3 + 3, so old rows i-1, i and i+1 always lie one after
+ *              the other from slot (i-1) % 3 and jacobi_row can read them
+ *              as a three row grid. Row i+1 is still old in the grid when
+ *              row i is written, except at the end of the band, where it
+ *              comes from the halo of the band below
+ *              
+ * Input args:  this_arg (thread argument structure)
+ * Return val:  NULL
+ */  /*  */
+void *
+inplace_worker (void *this_arg)
+{
+    ARGS_FOR_THREAD_t *args_for_me = (ARGS_FOR_THREAD_t *) this_arg;
+    int tid = args_for_me->tid;
+    int num_threads = args_for_me->num_threads;
+    int dim = grid_multi_0->dim;
+    float *g = grid_multi_0->element;
+    float eps = 1e-6;
+    int lag = (check_interval == CHECK_ASYNC) ? 1 : 0;
+    int num_rows = dim - 2;
+    int row_start = 1 + (int) ((long) tid * num_rows / num_threads);
+    int row_end = 1 + (int) ((long) (tid + 1) * num_rows / num_threads);
+    size_t row_size = sizeof (float) * dim;
+    int i;
+
+    float *window = (float *) aligned_alloc (CACHE_LINE, (6 * row_size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE);
+    if (window == NULL) {
+        perror ("aligned_alloc");
+        exit (EXIT_FAILURE);
+    }
+
+    /* edges of the band for the first iteration */
+    if (row_end > row_start) {
+        memcpy (inplace_halo (tid, 0, args_for_me->num_iter % 2, dim), &g[(long) row_start * dim], row_size);
+        memcpy (inplace_halo (tid, 1, args_for_me->num_iter % 2, dim), &g[(long) (row_end - 1) * dim], row_size);
+    }
+    if (profile_enabled)
+        profile_thread_enter (tid);
+    pthread_barrier_wait (&barrier_multi);
+    if (profile_enabled)
+        profile_wait_end (tid);
+
+    for (;;) {
+        int num_iter = args_for_me->num_iter;
+        int parity = num_iter % 2;
+        int check = lag || (num_iter + 1) % check_interval == 0;
+        double diff = 0.0;
+        long num_elements = 0;
+
+        if (profile_enabled)
+            profile_compute_begin (tid);
+        if (row_end > row_start) {
+            /* old row_start - 1 and row_start */
+            const float *above = (row_start == 1) ? g : inplace_halo (tid - 1, 1, parity, dim);
+            memcpy (&window[((row_start - 1) % 3) * dim], above, row_size);
+            memcpy (&window[((row_start - 1) % 3 + 3) * dim], above, row_size);
+            memcpy (&window[(row_start % 3) * dim], &g[(long) row_start * dim], row_size);
+            memcpy (&window[(row_start % 3 + 3) * dim], &g[(long) row_start * dim], row_size);
+
+            for (i = row_start; i < row_end; i++) {
+                const float *below;
+                if (i + 1 < row_end || i + 1 == dim - 1)
+                    below = &g[(long) (i + 1) * dim];
+                else
+                    below = inplace_halo (tid + 1, 0, parity, dim);
+                memcpy (&window[((i + 1) % 3) * dim], below, row_size);
+                memcpy (&window[((i + 1) % 3 + 3) * dim], below, row_size);
+
+                diff += jacobi_row (&window[((i - 1) % 3) * dim], &g[(long) (i - 1) * dim], dim, 1, 1, dim - 1);
+                num_elements += dim - 2;
+            }
+
+            /* the new edges are the old ones of the next iteration */
+            memcpy (inplace_halo (tid, 0, 1 - parity, dim), &g[(long) row_start * dim], row_size);
+            memcpy (inplace_halo (tid, 1, 1 - parity, dim), &g[(long) (row_end - 1) * dim], row_size);
+        }
+        PARTIAL_DIFF_t *partial = &partial_multi[parity * num_threads + tid];
+        partial->diff = diff;
+        partial->num_elements = num_elements;
+        if (profile_enabled)
+            profile_compute_end (tid, num_iter + 1);
+
+        if (pthread_barrier_wait (&barrier_multi) == PTHREAD_BARRIER_SERIAL_THREAD && check) {
+            double test = record_verdict (num_iter, num_threads, eps);
+            /* there is no second grid to keep, so the grid can only be copied while the team waits */
+            if (!lag) {
+                checkpoint_post (grid_multi_0, num_iter + 1, test);
+                snapshot_post (grid_multi_0, num_iter + 1, test);
+            }
+        }
+        if (check && !lag)
+            pthread_barrier_wait (&barrier_multi);
+        if (profile_enabled)
+            profile_wait_end (tid);
+
+        /* stop once the verdict on iteration num_iter - lag is in */
+        int converged = __atomic_load_n (&converged_multi, __ATOMIC_ACQUIRE);
+        if (converged >= 0 && converged <= num_iter - lag)
+            break;
+        if (max_iter_multi > 0 && num_iter + 1 >= max_iter_multi)
+            break;
+        args_for_me->num_iter++;
+    }
+
+    if (profile_enabled)
+        profile_thread_exit (tid);
+    free ((void *) window);
+    if (tid == 0)
+        num_iter_multi = args_for_me->num_iter + 1;
+    return NULL;
+}
+
+/*------------------------------------------------------------------
+ * Function:    reduce_diff
+ * Purpose:     Sum the partial diffs the threads wrote in iteration num_iter
+ *              
+ * Input args:  num_iter, num_threads
+ * Return val:  mean |new - old| over the grid
+ */  /*  */
+double
+reduce_diff (int num_iter, int num_threads)
+{
+    PARTIAL_DIFF_t *partial = &partial_multi[(num_iter % 2) * num_threads];
+    double diff = 0.0;
+    long num_elements = 0;
+
+    for (int i = 0; i < num_threads; i++) {
+        diff += partial[i].diff;
+        num_elements += partial[i].num_elements;
+    }
+    return diff/num_elements;
+}
+
+/*------------------------------------------------------------------
+ * Function:    record_verdict
+ * Purpose:     Convergence test of the pool solvers, run by the serial
+ *              thread: reduce and log the diff of iteration num_iter and,
+ *              if it is under eps, make num_iter the verdict in
+ *              converged_multi. Only the first verdict is stored. With
+ *              CHECK_ASYNC the next test can pass too while some threads
+ *              have not read the first one yet; moving the verdict on would
+ *              keep them at the barrier after the others left
+ *              
+ * Input args:  num_iter, num_threads, eps
+ * Return val:  the diff
+ */  /*  */
+double
+record_verdict (int num_iter, int num_threads, float eps)
+{
+    double test = reduce_diff (num_iter, num_threads);
+    int unset = -1;
+
+    log_diff (num_iter + 1, test);
+    if (test < eps)
+        __atomic_compare_exchange_n (&converged_multi, &unset, num_iter, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    return test;
+}
+
+/* Remember the diff of a convergence test, to be printed after the solve. */
+void
+log_diff (int num_iter, double diff)
+{
+    if (diff_log_len == diff_log_size) {
+        diff_log_size = (diff_log_size == 0) ? 1024 : 2 * diff_log_size;
+        diff_log = (DIFF_LOG_t *) realloc (diff_log, diff_log_size * sizeof (DIFF_LOG_t));
+        if (diff_log == NULL) {
+            perror ("realloc");
+            exit (EXIT_FAILURE);
+        }
+    }
+    diff_log[diff_log_len].num_iter = num_iter;
+    diff_log[diff_log_len].diff = diff;
+    diff_log_len++;
+}
+
+/* Forget the convergence tests of the last solve. */
+void
+clear_diff_log (void)
+{
+    diff_log_len = 0;
+}
+
+/* Print the convergence tests of the last solve. */
+void
+print_diff_log (void)
+{
+    for (int i = 0; i < diff_log_len; i++)
+        printf ("Iteration: %d - DIFF: %f\n", diff_log[i].num_iter, diff_log[i].diff);
+    diff_log_len = 0;
+}
+
+/*------------------------------------------------------------------
+ * Function:    pthreads_solver
+ * Purpose:     Calculate the value for every element in the grid in a multi-thread fashion 
+ *              they read from one grid and write to another, switching between
+ *              grids so the newest one is always being read from.
+ *              With DECOMP_CYCLIC each thread processes every num_threads-th row,
+ *              with DECOMP_BLOCK each thread owns a contiguous band of rows and
+ *              sweeps it one column tile at a time so the three rows a tile
+ *              touches stay in cache
+ *              
+ * Input args:  this_arg (thread argument structure)
+ * Return val:  none 
+ */  /*  */
+void
+pthreads_solver(void* this_arg)
+{
+    ARGS_FOR_THREAD_t *args_for_me = (ARGS_FOR_THREAD_t *) this_arg;
+    int profiled = profile_enabled;
+
+    int i, j;
+	double diff = 0.0;
+    long num_elements = 0;
+    int num_iter = args_for_me->num_iter;
+    int tid = args_for_me->tid;
+    int num_threads = args_for_me->num_threads;
+    grid_t *read_grid, *write_grid;
+
+    /* switch read and write grids every iteration */
+    if (num_iter %2 == 1){
+        read_grid = grid_multi_0;
+        write_grid = grid_multi_1;
+    } else {
+        read_grid = grid_multi_1;
+        write_grid = grid_multi_0;
+    }
+    int dim = read_grid->dim;
+
+    /* the pool opens its counters once, threads created for one iteration do it here */
+    if (profiled) {
+        if (args_for_me->one_shot)
+            profile_thread_enter (tid);
+        profile_compute_begin (tid);
+    }
+
+    /* the interior lines of the grid, its rows if it is 2-D, see stencil_line */
+    long n, num_lines = stencil_lines (dim);
+
+    if (decomposition == DECOMP_CYCLIC) {
+        for (n = tid; n < num_lines; n += num_threads) { /* each thread processes a different line */
+            i = stencil_line (n, dim);
+            diff += jacobi_row (read_grid->element, write_grid->element, dim, i, 1, dim - 1);
+            num_elements += dim - 2;
+        }
+    } else {
+        /* lines [line_start, line_end) belong to this thread */
+        long line_start = tid * num_lines / num_threads;
+        long line_end = (tid + 1) * num_lines / num_threads;
+        int tile = (tile_width > 0) ? tile_width : dim;
+
+        for (j = 1; j < (dim - 1); j += tile) {
+            int j_end = (j + tile < dim - 1) ? j + tile : dim - 1;
+            for (n = line_start; n < line_end; n++) {
+                i = stencil_line (n, dim);
+                diff += jacobi_row (read_grid->element, write_grid->element, dim, i, j, j_end);
+                num_elements += j_end - j;
+            }
+        }
+    }
+
+    /* publish this thread's share, reduce_diff adds them up */
+    PARTIAL_DIFF_t *partial = &partial_multi[(num_iter % 2) * num_threads + tid];
+    partial->diff = diff;
+    partial->num_elements = num_elements;
+    if (profiled) {
+        profile_compute_end (tid, num_iter + 1);
+        if (args_for_me->one_shot)
+            profile_thread_exit (tid);
+    }
+    return;
+
+}
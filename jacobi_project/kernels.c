@@ -0,0 +1,229 @@
+/* Row kernels for the 5-point Jacobi update.
+ *
+ * Every kernel applies new = 0.25 * (north + south + east + west) to columns
+ * [j_start, j_end) of one row and returns the sum of |new - old| over them.
+ * The sum of the four neighbours is formed in the same order as the scalar
+ * code, so all kernels produce bit-identical grids; only the order in which
+ * the diff is accumulated differs.
+ *
+ * jacobi_row points at the kernel in use. select_kernel picks one by name,
+ * "auto" takes the widest one cpuid reports as supported. The kernels of
+ * the stencil engine are picked in stencil.c, so this file links on its
+ * own.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "grid.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+double jacobi_row_scalar (const float *, float *, int, int, int, int);
+
+/* Kernel used by all solvers */
+double (*jacobi_row) (const float *, float *, int, int, int, int) = jacobi_row_scalar;
+const char *kernel_name = "scalar";
+
+/*------------------------------------------------------------------
+ * Function:    jacobi_row_scalar
+ * Purpose:     Apply the update rule to columns [j_start, j_end) of row i,
+ *              reading from src and writing to dst
+ *
+ * Input args:  src, dst, dim, i, j_start, j_end
+ * Return val:  sum of |new - old| over the updated points
+ */  /*  */
+double
+jacobi_row_scalar (const float *src, float *dst, int dim, int i, int j_start, int j_end)
+{
+    const float *up = src + (long) (i - 1) * dim;
+    const float *row = src + (long) i * dim;
+    const float *down = src + (long) (i + 1) * dim;
+    float *out = dst + (long) i * dim;
+	float old, new;
+    double diff = 0.0;
+    int j;
+
+    for (j = j_start; j < j_end; j++) {
+        old = row[j]; /* Store old value of grid point from read grid. */
+        /* Apply the update rule. */
+        new = 0.25 * (up[j] + down[j] + row[j + 1] + row[j - 1]);
+        out[j] = new; /* Update the grid-point value on write grid. */
+        diff = diff + fabs(new - old); /* Calculate the difference in values. */
+    }
+    return diff;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/* SSE2 version, 4 points per step. The |new - old| of each lane is widened
+ * to double before it is accumulated, like the scalar code does. */
+__attribute__ ((target ("sse2")))
+double
+jacobi_row_sse (const float *src, float *dst, int dim, int i, int j_start, int j_end)
+{
+    const float *up = src + (long) (i - 1) * dim;
+    const float *row = src + (long) i * dim;
+    const float *down = src + (long) (i + 1) * dim;
+    float *out = dst + (long) i * dim;
+    const __m128 quarter = _mm_set1_ps (0.25f);
+    const __m128 abs_mask = _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff));
+    __m128d acc_lo = _mm_setzero_pd ();
+    __m128d acc_hi = _mm_setzero_pd ();
+    double diff;
+    int j = j_start;
+
+    for (; j + 4 <= j_end; j += 4) {
+        __m128 old = _mm_loadu_ps (row + j);
+        __m128 sum = _mm_add_ps (_mm_loadu_ps (up + j), _mm_loadu_ps (down + j));
+        sum = _mm_add_ps (sum, _mm_loadu_ps (row + j + 1));
+        sum = _mm_add_ps (sum, _mm_loadu_ps (row + j - 1));
+        __m128 new = _mm_mul_ps (sum, quarter);
+        _mm_storeu_ps (out + j, new);
+
+        __m128 d = _mm_and_ps (_mm_sub_ps (new, old), abs_mask);
+        acc_lo = _mm_add_pd (acc_lo, _mm_cvtps_pd (d));
+        acc_hi = _mm_add_pd (acc_hi, _mm_cvtps_pd (_mm_movehl_ps (d, d)));
+    }
+
+    double lanes[2];
+    _mm_storeu_pd (lanes, _mm_add_pd (acc_lo, acc_hi));
+    diff = lanes[0] + lanes[1];
+    if (j < j_end)
+        diff += jacobi_row_scalar (src, dst, dim, i, j, j_end);
+    return diff;
+}
+
+/* AVX2 version, 8 points per step. */
+__attribute__ ((target ("avx2")))
+double
+jacobi_row_avx2 (const float *src, float *dst, int dim, int i, int j_start, int j_end)
+{
+    const float *up = src + (long) (i - 1) * dim;
+    const float *row = src + (long) i * dim;
+    const float *down = src + (long) (i + 1) * dim;
+    float *out = dst + (long) i * dim;
+    const __m256 quarter = _mm256_set1_ps (0.25f);
+    const __m256 abs_mask = _mm256_castsi256_ps (_mm256_set1_epi32 (0x7fffffff));
+    __m256d acc_lo = _mm256_setzero_pd ();
+    __m256d acc_hi = _mm256_setzero_pd ();
+    double diff;
+    int j = j_start;
+
+    for (; j + 8 <= j_end; j += 8) {
+        __m256 old = _mm256_loadu_ps (row + j);
+        __m256 sum = _mm256_add_ps (_mm256_loadu_ps (up + j), _mm256_loadu_ps (down + j));
+        sum = _mm256_add_ps (sum, _mm256_loadu_ps (row + j + 1));
+        sum = _mm256_add_ps (sum, _mm256_loadu_ps (row + j - 1));
+        __m256 new = _mm256_mul_ps (sum, quarter);
+        _mm256_storeu_ps (out + j, new);
+
+        __m256 d = _mm256_and_ps (_mm256_sub_ps (new, old), abs_mask);
+        acc_lo = _mm256_add_pd (acc_lo, _mm256_cvtps_pd (_mm256_castps256_ps128 (d)));
+        acc_hi = _mm256_add_pd (acc_hi, _mm256_cvtps_pd (_mm256_extractf128_ps (d, 1)));
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd (lanes, _mm256_add_pd (acc_lo, acc_hi));
+    diff = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    if (j < j_end)
+        diff += jacobi_row_scalar (src, dst, dim, i, j, j_end);
+    return diff;
+}
+
+/* AVX-512 version, 16 points per step. */
+__attribute__ ((target ("avx512f")))
+double
+jacobi_row_avx512 (const float *src, float *dst, int dim, int i, int j_start, int j_end)
+{
+    const float *up = src + (long) (i - 1) * dim;
+    const float *row = src + (long) i * dim;
+    const float *down = src + (long) (i + 1) * dim;
+    float *out = dst + (long) i * dim;
+    const __m512 quarter = _mm512_set1_ps (0.25f);
+    __m512d acc_lo = _mm512_setzero_pd ();
+    __m512d acc_hi = _mm512_setzero_pd ();
+    double diff;
+    int j = j_start;
+
+    for (; j + 16 <= j_end; j += 16) {
+        __m512 old = _mm512_loadu_ps (row + j);
+        __m512 sum = _mm512_add_ps (_mm512_loadu_ps (up + j), _mm512_loadu_ps (down + j));
+        sum = _mm512_add_ps (sum, _mm512_loadu_ps (row + j + 1));
+        sum = _mm512_add_ps (sum, _mm512_loadu_ps (row + j - 1));
+        __m512 new = _mm512_mul_ps (sum, quarter);
+        _mm512_storeu_ps (out + j, new);
+
+        __m512 d = _mm512_abs_ps (_mm512_sub_ps (new, old));
+        acc_lo = _mm512_add_pd (acc_lo, _mm512_cvtps_pd (_mm512_castps512_ps256 (d)));
+        acc_hi = _mm512_add_pd (acc_hi, _mm512_cvtps_pd (_mm256_castpd_ps (_mm512_extractf64x4_pd (_mm512_castps_pd (d), 1))));
+    }
+
+    diff = _mm512_reduce_add_pd (_mm512_add_pd (acc_lo, acc_hi));
+    if (j < j_end)
+        diff += jacobi_row_scalar (src, dst, dim, i, j, j_end);
+    return diff;
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+/*------------------------------------------------------------------
+ * Function:    select_kernel
+ * Purpose:     Point jacobi_row at the kernel called name: scalar, sse,
+ *              avx2, avx512, or auto for the widest one this CPU
+ *              supports
+ *
+ * Input args:  name
+ * Return val:  0 on success, -1 if the kernel is unknown or not supported
+ */  /*  */
+int
+select_kernel (const char *name)
+{
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init ();
+    int has_sse = __builtin_cpu_supports ("sse2");
+    int has_avx2 = __builtin_cpu_supports ("avx2");
+    int has_avx512 = __builtin_cpu_supports ("avx512f");
+
+    if (strcmp (name, "auto") == 0) {
+        if (has_avx512)
+            name = "avx512";
+        else if (has_avx2)
+            name = "avx2";
+        else if (has_sse)
+            name = "sse";
+        else
+            name = "scalar";
+    }
+
+    if (strcmp (name, "avx512") == 0 && has_avx512) {
+        jacobi_row = jacobi_row_avx512;
+        kernel_name = "avx512";
+        return 0;
+    }
+    if (strcmp (name, "avx2") == 0 && has_avx2) {
+        jacobi_row = jacobi_row_avx2;
+        kernel_name = "avx2";
+        return 0;
+    }
+    if (strcmp (name, "sse") == 0 && has_sse) {
+        jacobi_row = jacobi_row_sse;
+        kernel_name = "sse";
+        return 0;
+    }
+#else
+    if (strcmp (name, "auto") == 0)
+        name = "scalar";
+#endif
+    if (strcmp (name, "scalar") == 0) {
+        jacobi_row = jacobi_row_scalar;
+        kernel_name = "scalar";
+        return 0;
+    }
+    return -1;
+}
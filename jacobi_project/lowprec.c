@@ -0,0 +1,413 @@
+/* Jacobi solver with 16-bit grid storage.
+ *
+ * A Jacobi sweep does four additions and a multiply per point, far too
+ * little to hide the memory traffic, so it runs at the speed of memory.
+ * Storing the grids as 16-bit numbers halves the bytes moved per sweep.
+ * Points are widened to float, updated in float and rounded back on store:
+ *
+ *  - STORAGE_BF16: bfloat16, the top half of a float. Same range as float,
+ *    8 significant bits. Converted with integer operations, so it works on
+ *    any CPU.
+ *  - STORAGE_FP16: IEEE half. 11 significant bits, but values above 65504
+ *    overflow. Converted with the F16C instructions, so x86 only.
+ *
+ * Once the changes per sweep get down to about an ulp of the stored values
+ * they are lost to rounding and the grid stops moving: the 16-bit grid has
+ * reached its precision floor. The kernels sum both the change the float
+ * arithmetic asked for and the change that survived the rounding. When less
+ * than LP_MIN_KEPT of it survives, or when the diff has not improved for
+ * LP_STALL_ITER iterations, the serial thread widens the newest grid to
+ * float and the team carries on with jacobi_row until the diff drops
+ * below eps, like compute_using_pthreads_jacobi_pool. A 16-bit grid is
+ * never reported as converged.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <math.h>
+#include "grid.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_F16C_KERNEL
+#endif
+
+#define LP_MIN_KEPT 0.75    /* Switch to float once rounding eats more than a quarter of the change */
+#define LP_STALL_ITER 200   /* Switch to float if the diff has not improved for this many iterations */
+
+/* Stall test, kept by whichever thread is serial at the barrier */
+typedef struct lp_floor_s {
+    double best_diff;
+    int best_iter;          /* Iteration best_diff was seen at */
+} LP_FLOOR_t;
+
+/* Structure that holds the arguments for the low-precision threads */
+typedef struct lp_args_s {
+    int tid;                /* Thread ID */
+    int num_threads;
+    int dim;
+    int *storage;           /* Storage in use, changed only by the serial thread */
+    uint16_t **grid16;      /* Two 16-bit grids, iteration n reads grid16[n % 2] */
+    float **grid32;         /* Two float grids, allocated when the team switches */
+    double *diff;           /* One partial diff per thread */
+    double *wanted;         /* One partial diff before rounding per thread */
+    int *num_iter;
+    int *switch_iter;       /* Iteration the team switched to float at */
+    LP_FLOOR_t *lp_floor;
+    int *done;
+    pthread_barrier_t *barrier;
+} LP_ARGS_t;
+
+void * lowprec_worker (void *);
+
+/* bfloat16 <-> float, rounding to nearest even */
+static inline float
+bf16_to_float (uint16_t h)
+{
+    uint32_t bits = (uint32_t) h << 16;
+    float f;
+    memcpy (&f, &bits, sizeof (f));
+    return f;
+}
+
+static inline uint16_t
+float_to_bf16 (float f)
+{
+    uint32_t bits;
+    memcpy (&bits, &f, sizeof (bits));
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return (uint16_t) (bits >> 16);
+}
+
+/*------------------------------------------------------------------
+ * Function:    jacobi_row_bf16
+ * Purpose:     jacobi_row on bfloat16 grids: apply the update rule to
+ *              columns [j_start, j_end) of row i in float and round the
+ *              result to bfloat16
+ *
+ * Input args:  src, dst, dim, i, j_start, j_end
+ * Output args: wanted (|new - old| before rounding is added to it)
+ * Return val:  sum of |new - old| over the updated points, as stored
+ */  /*  */
+double
+jacobi_row_bf16 (const uint16_t *src, uint16_t *dst, int dim, int i, int j_start, int j_end, double *wanted)
+{
+    const uint16_t *up = src + (long) (i - 1) * dim;
+    const uint16_t *row = src + (long) i * dim;
+    const uint16_t *down = src + (long) (i + 1) * dim;
+    uint16_t *out = dst + (long) i * dim;
+    double diff = 0.0, asked = 0.0;
+    int j;
+
+    for (j = j_start; j < j_end; j++) {
+        float old = bf16_to_float (row[j]);
+        float new = 0.25 * (bf16_to_float (up[j]) + bf16_to_float (down[j])
+                            + bf16_to_float (row[j + 1]) + bf16_to_float (row[j - 1]));
+        out[j] = float_to_bf16 (new);
+        diff = diff + fabs (bf16_to_float (out[j]) - old);
+        asked = asked + fabs (new - old);
+    }
+    *wanted += asked;
+    return diff;
+}
+
+#ifdef HAVE_F16C_KERNEL
+
+/* jacobi_row on IEEE half grids, 8 points per step. */
+__attribute__ ((target ("avx,f16c")))
+double
+jacobi_row_fp16 (const uint16_t *src, uint16_t *dst, int dim, int i, int j_start, int j_end, double *wanted)
+{
+    const uint16_t *up = src + (long) (i - 1) * dim;
+    const uint16_t *row = src + (long) i * dim;
+    const uint16_t *down = src + (long) (i + 1) * dim;
+    uint16_t *out = dst + (long) i * dim;
+    const __m256 quarter = _mm256_set1_ps (0.25f);
+    const __m256 abs_mask = _mm256_castsi256_ps (_mm256_set1_epi32 (0x7fffffff));
+    __m256d acc = _mm256_setzero_pd ();
+    __m256d acc_asked = _mm256_setzero_pd ();
+    double diff, asked;
+    int j = j_start;
+
+#define LOAD_HALF(p) _mm256_cvtph_ps (_mm_loadu_si128 ((const __m128i *) (p)))
+    for (; j + 8 <= j_end; j += 8) {
+        __m256 old = LOAD_HALF (row + j);
+        __m256 sum = _mm256_add_ps (LOAD_HALF (up + j), LOAD_HALF (down + j));
+        sum = _mm256_add_ps (sum, LOAD_HALF (row + j + 1));
+        sum = _mm256_add_ps (sum, LOAD_HALF (row + j - 1));
+        __m256 exact = _mm256_mul_ps (sum, quarter);
+        __m128i new = _mm256_cvtps_ph (exact, _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128 ((__m128i *) (out + j), new);
+
+        __m256 d = _mm256_and_ps (_mm256_sub_ps (_mm256_cvtph_ps (new), old), abs_mask);
+        acc = _mm256_add_pd (acc, _mm256_cvtps_pd (_mm256_castps256_ps128 (d)));
+        acc = _mm256_add_pd (acc, _mm256_cvtps_pd (_mm256_extractf128_ps (d, 1)));
+        d = _mm256_and_ps (_mm256_sub_ps (exact, old), abs_mask);
+        acc_asked = _mm256_add_pd (acc_asked, _mm256_cvtps_pd (_mm256_castps256_ps128 (d)));
+        acc_asked = _mm256_add_pd (acc_asked, _mm256_cvtps_pd (_mm256_extractf128_ps (d, 1)));
+    }
+#undef LOAD_HALF
+
+    double lanes[4];
+    _mm256_storeu_pd (lanes, acc);
+    diff = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_storeu_pd (lanes, acc_asked);
+    asked = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; j < j_end; j++) {
+        float old = _cvtsh_ss (row[j]);
+        float new = 0.25 * (_cvtsh_ss (up[j]) + _cvtsh_ss (down[j]) + _cvtsh_ss (row[j + 1]) + _cvtsh_ss (row[j - 1]));
+        out[j] = _cvtss_sh (new, _MM_FROUND_TO_NEAREST_INT);
+        diff = diff + fabs (_cvtsh_ss (out[j]) - old);
+        asked = asked + fabs (new - old);
+    }
+    *wanted += asked;
+    return diff;
+}
+
+/* Convert n floats to IEEE half. */
+__attribute__ ((target ("f16c")))
+static void
+floats_to_fp16 (const float *src, uint16_t *dst, long n)
+{
+    for (long k = 0; k < n; k++)
+        dst[k] = _cvtss_sh (src[k], _MM_FROUND_TO_NEAREST_INT);
+}
+
+/* Convert n IEEE halfs to float. */
+__attribute__ ((target ("f16c")))
+static void
+fp16_to_floats (const uint16_t *src, float *dst, long n)
+{
+    for (long k = 0; k < n; k++)
+        dst[k] = _cvtsh_ss (src[k]);
+}
+
+#endif /* HAVE_F16C_KERNEL */
+
+/*------------------------------------------------------------------
+ * Function:    storage_supported
+ * Purpose:     Tell if this CPU can run the given storage format
+ *
+ * Input args:  storage
+ * Return val:  1 if it can, 0 if not
+ */  /*  */
+int
+storage_supported (int storage)
+{
+    if (storage == STORAGE_FP32 || storage == STORAGE_BF16)
+        return 1;
+#ifdef HAVE_F16C_KERNEL
+    __builtin_cpu_init ();
+    if (storage == STORAGE_FP16)
+        return __builtin_cpu_supports ("avx") && __builtin_cpu_supports ("f16c");
+#endif
+    return 0;
+}
+
+/* Name of a storage format. */
+const char *
+storage_name (int storage)
+{
+    return (storage == STORAGE_BF16) ? "bf16" : (storage == STORAGE_FP16) ? "fp16" : "fp32";
+}
+
+/* Convert n values between float and 16-bit storage. */
+static void
+convert_to_16 (int storage, const float *src, uint16_t *dst, long n)
+{
+#ifdef HAVE_F16C_KERNEL
+    if (storage == STORAGE_FP16) {
+        floats_to_fp16 (src, dst, n);
+        return;
+    }
+#endif
+    for (long k = 0; k < n; k++)
+        dst[k] = float_to_bf16 (src[k]);
+}
+
+static void
+convert_from_16 (int storage, const uint16_t *src, float *dst, long n)
+{
+#ifdef HAVE_F16C_KERNEL
+    if (storage == STORAGE_FP16) {
+        fp16_to_floats (src, dst, n);
+        return;
+    }
+#endif
+    for (long k = 0; k < n; k++)
+        dst[k] = bf16_to_float (src[k]);
+}
+
+/*------------------------------------------------------------------
+ * Function:    compute_using_lowprec_jacobi
+ * Purpose:     Solve the grid in place with the Jacobi method using
+ *              num_threads persistent threads, keeping the grids in the 16-bit
+ *              format storage until the diff reaches its precision floor and
+ *              in float from then on
+ *
+ * Input args:  grid, num_threads, storage (STORAGE_BF16 or STORAGE_FP16)
+ * Output args: num_iter
+ * Return val:  grid
+ */  /*  */
+grid_t *
+compute_using_lowprec_jacobi (grid_t *grid, int num_threads, int storage, int *num_iter)
+{
+    int dim = grid->dim;
+    long size = (long) dim * dim;
+    int current = storage;
+    int switch_iter = -1;
+    LP_FLOOR_t lp_floor = {INFINITY, 0};
+    int done = 0;
+    int i;
+    pthread_barrier_t barrier;
+    uint16_t *grid16[2];
+    float *grid32[2] = {NULL, NULL};
+
+    if (num_threads < 1)
+        num_threads = 1;
+    pthread_t *worker_thread = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+    LP_ARGS_t *args_for_thread = (LP_ARGS_t *) malloc (num_threads * sizeof (LP_ARGS_t));
+    double *diff = (double *) malloc (2 * num_threads * sizeof (double));
+    grid16[0] = (uint16_t *) malloc (size * sizeof (uint16_t));
+    grid16[1] = (uint16_t *) malloc (size * sizeof (uint16_t));
+    if (worker_thread == NULL || args_for_thread == NULL || diff == NULL || grid16[0] == NULL || grid16[1] == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    convert_to_16 (storage, grid->element, grid16[0], size);
+    memcpy (grid16[1], grid16[0], size * sizeof (uint16_t));
+
+    *num_iter = 0;
+    pthread_barrier_init (&barrier, NULL, num_threads);
+    for (i = 0; i < num_threads; i++) {
+        args_for_thread[i].tid = i;
+        args_for_thread[i].num_threads = num_threads;
+        args_for_thread[i].dim = dim;
+        args_for_thread[i].storage = &current;
+        args_for_thread[i].grid16 = grid16;
+        args_for_thread[i].grid32 = grid32;
+        args_for_thread[i].diff = diff;
+        args_for_thread[i].wanted = diff + num_threads;
+        args_for_thread[i].num_iter = num_iter;
+        args_for_thread[i].switch_iter = &switch_iter;
+        args_for_thread[i].lp_floor = &lp_floor;
+        args_for_thread[i].done = &done;
+        args_for_thread[i].barrier = &barrier;
+
+        if ((create_solver_thread (&worker_thread[i], i, num_threads, lowprec_worker, (void *)&args_for_thread[i])) != 0) {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < num_threads; i++)
+        pthread_join (worker_thread[i], NULL);
+
+    /* the newest grid is the one the next iteration would read */
+    memcpy (grid->element, grid32[*num_iter % 2], size * sizeof (float));
+    printf ("Used %s storage for %d of %d iterations\n", storage_name (storage), switch_iter, *num_iter);
+
+    pthread_barrier_destroy (&barrier);
+    free ((void *) worker_thread);
+    free ((void *) args_for_thread);
+    free ((void *) diff);
+    free ((void *) grid16[0]);
+    free ((void *) grid16[1]);
+    free ((void *) grid32[0]);
+    free ((void *) grid32[1]);
+    return grid;
+}
+
+/*------------------------------------------------------------------
+ * Function:    lowprec_worker
+ * Purpose:     Sweep the thread's band of rows in the current storage, wait,
+ *              and let the serial thread test the diff: in 16-bit storage
+ *              against the precision floor, in float against eps
+ *
+ * Input args:  this_arg (thread argument structure)
+ * Return val:  NULL
+ */  /*  */
+void *
+lowprec_worker (void *this_arg)
+{
+    LP_ARGS_t *args_for_me = (LP_ARGS_t *) this_arg;
+    int dim = args_for_me->dim;
+    int tid = args_for_me->tid;
+    int num_threads = args_for_me->num_threads;
+    long size = (long) dim * dim;
+    LP_FLOOR_t *lp_floor = args_for_me->lp_floor;
+    float eps = 1e-6;
+    int i;
+
+    /* rows [row_start, row_end) belong to this thread */
+    int num_rows = dim - 2;
+    int row_start = 1 + (int) ((long) tid * num_rows / num_threads);
+    int row_end = 1 + (int) ((long) (tid + 1) * num_rows / num_threads);
+
+    while (!*args_for_me->done) {
+        int n = *args_for_me->num_iter;
+        int storage = *args_for_me->storage;
+        double diff = 0.0, wanted = 0.0;
+
+        for (i = row_start; i < row_end; i++) {
+            if (storage == STORAGE_FP32)
+                diff += jacobi_row (args_for_me->grid32[n % 2], args_for_me->grid32[(n + 1) % 2], dim, i, 1, dim - 1);
+#ifdef HAVE_F16C_KERNEL
+            else if (storage == STORAGE_FP16)
+                diff += jacobi_row_fp16 (args_for_me->grid16[n % 2], args_for_me->grid16[(n + 1) % 2], dim, i, 1, dim - 1, &wanted);
+#endif
+            else
+                diff += jacobi_row_bf16 (args_for_me->grid16[n % 2], args_for_me->grid16[(n + 1) % 2], dim, i, 1, dim - 1, &wanted);
+        }
+        args_for_me->diff[tid] = diff;
+        args_for_me->wanted[tid] = wanted;
+
+        if (pthread_barrier_wait (args_for_me->barrier) == PTHREAD_BARRIER_SERIAL_THREAD) {
+            double test = 0.0;
+            for (i = 0; i < num_threads; i++)
+                test += args_for_me->diff[i];
+            test = test/((double) num_rows * num_rows);
+            n = ++(*args_for_me->num_iter);
+            log_diff (n, test);
+
+            if (storage == STORAGE_FP32) {
+                if (test < eps)
+                    *args_for_me->done = 1;
+            } else {
+                uint16_t *newest = args_for_me->grid16[n % 2];
+                double asked = 0.0;
+                for (i = 0; i < num_threads; i++)
+                    asked += args_for_me->wanted[i];
+                double kept = test/(asked/((double) num_rows * num_rows));
+                if (test < lp_floor->best_diff) {
+                    lp_floor->best_diff = test;
+                    lp_floor->best_iter = n;
+                }
+
+                if (kept < LP_MIN_KEPT || n - lp_floor->best_iter >= LP_STALL_ITER) {
+                    float **grid32 = args_for_me->grid32;
+                    grid32[0] = (float *) malloc (size * sizeof (float));
+                    grid32[1] = (float *) malloc (size * sizeof (float));
+                    if (grid32[0] == NULL || grid32[1] == NULL) {
+                        perror ("malloc");
+                        exit (EXIT_FAILURE);
+                    }
+                    convert_from_16 (storage, newest, grid32[n % 2], size);
+                    memcpy (grid32[(n + 1) % 2], grid32[n % 2], size * sizeof (float));
+                    *args_for_me->storage = STORAGE_FP32;
+                    *args_for_me->switch_iter = n;
+                    printf ("Switching from %s to fp32 storage after %d iterations, DIFF: %f, %.0f%% of the change kept\n",
+                            storage_name (storage), n, test, 100.0 * kept);
+                }
+            }
+        }
+        pthread_barrier_wait (args_for_me->barrier);    /* everyone sees done and the storage */
+    }
+    return NULL;
+}
@@ -0,0 +1,319 @@
+/* Multi-process Jacobi solver with halo exchange over shared memory.
+ *
+ * The grid is split into slabs of contiguous rows, one per process. Each
+ * process keeps its slab plus one ghost row above and below in private
+ * memory and sweeps it with jacobi_row, as a process on another node would.
+ * The only data that crosses between processes goes through one POSIX
+ * shared memory segment:
+ *
+ *  - halo rows: after a sweep a process copies its first and last row into
+ *    its halo slots and posts a semaphore of each neighbour, who waits for
+ *    it and copies the row into its ghost row. The slots are double buffered
+ *    by iteration parity; a process cannot get two iterations ahead of a
+ *    neighbour because it waits for the neighbour's halo every iteration.
+ *  - diff: on the iterations that test for convergence every process writes
+ *    its partial diff, posts the root (process 0), and waits until the root
+ *    has summed them and posted the verdict back.
+ *  - result: at the end each process copies its slab into a shared grid
+ *    that the parent reads.
+ *
+ * Convergence is tested every check_interval iterations, like the threaded
+ * jacobi solvers. The semaphores are process-shared sem_t, which block on
+ * a futex.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include "grid.h"
+
+#define HALO_TOP 0          /* First row of a slab, read by the process above */
+#define HALO_BOTTOM 1       /* Last row of a slab, read by the process below */
+
+/* Control block of one process, alone on its cache line */
+typedef struct halo_proc_s {
+    sem_t from_above;       /* Posted when the process above published its bottom row */
+    sem_t from_below;       /* Posted when the process below published its top row */
+    sem_t verdict;          /* Posted by the root once the diff is reduced */
+    double diff;            /* Partial diff of the last tested iteration */
+} __attribute__ ((aligned (64))) HALO_PROC_t;
+
+/* Start of the shared segment, followed by the halo rows and the result grid */
+typedef struct halo_ctl_s {
+    int num_procs;
+    int dim;
+    int done;               /* Set by the root when the diff is below eps */
+    int num_iter;           /* Iterations done, written by the root at the end */
+    sem_t gathered;         /* Posted by every other process once its diff is in */
+} HALO_CTL_t;
+
+static HALO_CTL_t *ctl;
+static HALO_PROC_t *proc;
+static float *halo;         /* [num_procs][2 sides][2 parities][dim] */
+static float *result;       /* dim x dim */
+
+/* Halo slot of process p for one side and iteration parity. */
+static float *
+halo_row (int p, int side, int parity)
+{
+    return halo + (((long) p * 2 + side) * 2 + parity) * ctl->dim;
+}
+
+/*------------------------------------------------------------------
+ * Function:    slab_solver
+ * Purpose:     Body of process p: solve rows [row_start, row_end) of grid,
+ *              exchanging halos with the neighbours every iteration, then
+ *              copy the slab into the shared result grid
+ *
+ * Input args:  grid, p, log (root keeps and prints the diff log)
+ * Return val:  none
+ */  /*  */
+static void
+slab_solver (const grid_t *grid, int p, int log)
+{
+    int dim = grid->dim;
+    int num_procs = ctl->num_procs;
+    int num_rows = dim - 2;
+    int row_start = 1 + (int) ((long) p * num_rows / num_procs);
+    int row_end = 1 + (int) ((long) (p + 1) * num_rows / num_procs);
+    int rows = row_end - row_start;
+    int interval = (check_interval > 0) ? check_interval : 1;
+    float eps = 1e-6;
+    int num_iter = 0;
+    int q, i;
+
+    /* local row r is global row row_start - 1 + r, rows 0 and rows + 1 are the ghosts */
+    size_t size = sizeof (float) * (size_t) (rows + 2) * dim;
+    float *cur = (float *) malloc (size);
+    float *next = (float *) malloc (size);
+    if (cur == NULL || next == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    memcpy (cur, &grid->element[(long) (row_start - 1) * dim], size);
+    memcpy (next, cur, size);
+
+    for (;;) {
+        int parity = num_iter % 2;
+        double diff = 0.0;
+        for (i = 1; i <= rows; i++)
+            diff += jacobi_row (cur, next, dim, i, 1, dim - 1);
+        num_iter++;
+
+        /* publish the rows the neighbours need, then pick up theirs */
+        if (p > 0) {
+            memcpy (halo_row (p, HALO_TOP, parity), &next[(long) dim], dim * sizeof (float));
+            sem_post (&proc[p - 1].from_below);
+        }
+        if (p < num_procs - 1) {
+            memcpy (halo_row (p, HALO_BOTTOM, parity), &next[(long) rows * dim], dim * sizeof (float));
+            sem_post (&proc[p + 1].from_above);
+        }
+        if (p > 0) {
+            sem_wait (&proc[p].from_above);
+            memcpy (next, halo_row (p - 1, HALO_BOTTOM, parity), dim * sizeof (float));
+        }
+        if (p < num_procs - 1) {
+            sem_wait (&proc[p].from_below);
+            memcpy (&next[(long) (rows + 1) * dim], halo_row (p + 1, HALO_TOP, parity), dim * sizeof (float));
+        }
+
+        float *tmp = cur;
+        cur = next;
+        next = tmp;
+
+        if (num_iter % interval != 0)
+            continue;
+
+        /* global diff: gather at the root, which posts the verdict back */
+        proc[p].diff = diff;
+        if (p == 0) {
+            for (q = 1; q < num_procs; q++)
+                sem_wait (&ctl->gathered);
+            double test = 0.0;
+            for (q = 0; q < num_procs; q++)
+                test += proc[q].diff;
+            test = test/((double) num_rows * num_rows);
+            if (log)
+                log_diff (num_iter, test);
+            ctl->done = (test < eps);
+            for (q = 1; q < num_procs; q++)
+                sem_post (&proc[q].verdict);
+        } else {
+            sem_post (&ctl->gathered);
+            sem_wait (&proc[p].verdict);
+        }
+        if (ctl->done)
+            break;
+    }
+
+    memcpy (&result[(long) row_start * dim], &cur[(long) dim], sizeof (float) * (size_t) rows * dim);
+    if (p == 0) {
+        ctl->num_iter = num_iter;
+        if (log)
+            print_diff_log ();
+    }
+    free ((void *) cur);
+    free ((void *) next);
+}
+
+/* Solve grid with num_procs processes, see compute_using_processes. */
+static grid_t *
+run_processes (grid_t *grid, int num_procs, int log, int *num_iter)
+{
+    int dim = grid->dim;
+    char name[64];
+    int p;
+
+    if (num_procs < 1)
+        num_procs = 1;
+    if (num_procs > dim - 2)
+        num_procs = dim - 2;
+
+    size_t halo_size = sizeof (float) * (size_t) num_procs * 4 * dim;
+    size_t size = sizeof (HALO_CTL_t) + num_procs * sizeof (HALO_PROC_t) + halo_size
+                  + sizeof (float) * (size_t) dim * dim + 128;
+
+    /* the name only lives until the children have inherited the mapping */
+    snprintf (name, sizeof (name), "/jacobi_halo_%d", (int) getpid ());
+    int fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        perror ("shm_open");
+        exit (EXIT_FAILURE);
+    }
+    if (ftruncate (fd, size) != 0) {
+        perror ("ftruncate");
+        exit (EXIT_FAILURE);
+    }
+    char *base = (char *) mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    shm_unlink (name);
+    if (base == MAP_FAILED) {
+        perror ("mmap");
+        exit (EXIT_FAILURE);
+    }
+
+    ctl = (HALO_CTL_t *) base;
+    proc = (HALO_PROC_t *) (base + ((sizeof (HALO_CTL_t) + 63) & ~63UL));
+    halo = (float *) (proc + num_procs);
+    result = halo + (size_t) num_procs * 4 * dim;
+
+    ctl->num_procs = num_procs;
+    ctl->dim = dim;
+    ctl->done = 0;
+    ctl->num_iter = 0;
+    sem_init (&ctl->gathered, 1, 0);
+    for (p = 0; p < num_procs; p++) {
+        sem_init (&proc[p].from_above, 1, 0);
+        sem_init (&proc[p].from_below, 1, 0);
+        sem_init (&proc[p].verdict, 1, 0);
+    }
+    /* the boundary rows are never written by the slabs */
+    memcpy (result, grid->element, sizeof (float) * (size_t) dim * dim);
+    fflush (stdout);    /* or the children flush the parent's buffered output again */
+
+    for (p = 0; p < num_procs; p++) {
+        pid_t pid = fork ();
+        if (pid < 0) {
+            perror ("fork");
+            exit (EXIT_FAILURE);
+        }
+        if (pid == 0) {
+            slab_solver (grid, p, log);
+            fflush (stdout);
+            _exit (EXIT_SUCCESS);
+        }
+    }
+    for (p = 0; p < num_procs; p++) {
+        int status;
+        if (wait (&status) < 0 || !WIFEXITED (status) || WEXITSTATUS (status) != EXIT_SUCCESS) {
+            printf ("A solver process failed\n");
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    memcpy (grid->element, result, sizeof (float) * (size_t) dim * dim);
+    *num_iter = ctl->num_iter;
+
+    sem_destroy (&ctl->gathered);
+    for (p = 0; p < num_procs; p++) {
+        sem_destroy (&proc[p].from_above);
+        sem_destroy (&proc[p].from_below);
+        sem_destroy (&proc[p].verdict);
+    }
+    munmap (base, size);
+    return grid;
+}
+
+/*------------------------------------------------------------------
+ * Function:    compute_using_processes
+ * Purpose:     Solve the grid in place with the Jacobi method, using
+ *              num_procs processes that own a slab of rows each and exchange
+ *              halos through shared memory
+ *
+ * Input args:  grid, num_procs
+ * Output args: num_iter
+ * Return val:  grid
+ */  /*  */
+grid_t *
+compute_using_processes (grid_t *grid, int num_procs, int *num_iter)
+{
+    return run_processes (grid, num_procs, 1, num_iter);
+}
+
+/*------------------------------------------------------------------
+ * Function:    report_process_scaling
+ * Purpose:     Solve copies of grid with 1, 2, 4, ... up to max_procs
+ *              processes and print time, update rate, speedup and
+ *              efficiency for each count
+ *
+ * Input args:  grid, max_procs
+ * Return val:  none
+ */  /*  */
+void
+report_process_scaling (grid_t *grid, int max_procs)
+{
+    int dim = grid->dim;
+    size_t size = sizeof (float) * (size_t) dim * dim;
+    grid_t copy;
+    struct timeval start, stop;
+    double base_time = 0.0;
+    int num_procs, num_iter;
+
+    copy.dim = dim;
+    copy.element = (float *) malloc (size);
+    if (copy.element == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    printf ("\nScaling of the multi-process solver on a %d x %d grid\n", dim, dim);
+    printf ("%6s %10s %12s %14s %9s %11s\n", "procs", "iterations", "time (s)", "updates/s", "speedup", "efficiency");
+    for (num_procs = 1; ; num_procs = (2 * num_procs < max_procs) ? 2 * num_procs : max_procs) {
+        memcpy (copy.element, grid->element, size);
+        gettimeofday (&start, NULL);
+        run_processes (&copy, num_procs, 0, &num_iter);
+        gettimeofday (&stop, NULL);
+        double time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000);
+
+        if (num_procs == 1)
+            base_time = time_taken;
+        printf ("%6d %10d %12f %14e %9.2f %10.1f%%\n", num_procs, num_iter, time_taken,
+                (double) (dim - 2) * (dim - 2) * num_iter/time_taken, base_time/time_taken,
+                100.0 * base_time/(time_taken * num_procs));
+        if (num_procs >= max_procs)
+            break;
+    }
+    printf ("\n");
+    free ((void *) copy.element);
+}
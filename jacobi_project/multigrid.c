@@ -0,0 +1,423 @@
+/* Geometric multigrid solver for grid_t.
+ *
+ * Jacobi and Gauss-Seidel remove high-frequency error quickly but need
+ * O(dim^2) sweeps for the smooth part, which is why the iteration count
+ * of the other solvers grows so fast with dim. Multigrid smooths on the
+ * fine grid, moves the remaining smooth error to a coarser grid where it
+ * is high-frequency again, and recurses. A V-cycle (or W-cycle) costs a
+ * few fine-grid sweeps and cuts the error by a fixed factor independent
+ * of dim, so the whole solve is O(N) work.
+ *
+ * Level l solves -lap(u) = f with spacing h_l (h_0 = 1). The fine level
+ * has f = 0 and the plate's boundary temperatures; coarser levels solve
+ * for the correction with zero boundaries. Coarse grids have about half
+ * the dimension of the finer one. When dim - 1 is even the coarse points
+ * land exactly on fine points and the operators are the textbook full
+ * weighting and bilinear interpolation; otherwise the same bilinear
+ * weights are evaluated at the scaled coordinates.
+ *
+ * The smoother is red-black Gauss-Seidel. All threads run the cycle
+ * together, splitting rows on levels of at least MG_PARALLEL_DIM and
+ * meeting at a barrier between steps; smaller levels are done by thread 0
+ * alone.
+ *
+ * The solve stops when the mean |0.25 * (N + S + E + W) - u| on the fine
+ * grid, which is what a Jacobi sweep would report as its diff, drops
+ * below the same eps as the Jacobi solver.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <math.h>
+#include "grid.h"
+
+#define MG_COARSEST_DIM 5       /* Stop coarsening at this dimension */
+#define MG_PARALLEL_DIM 128     /* Levels smaller than this are done by one thread */
+#define MG_PRE_SMOOTH 2         /* Red-black sweeps before going down a level */
+#define MG_POST_SMOOTH 2        /* Red-black sweeps after coming back up */
+#define MG_COARSEST_SWEEPS 50   /* Red-black sweeps that solve the coarsest level */
+
+/* One level of the hierarchy */
+typedef struct mg_level_s {
+    int dim;
+    double h2;              /* Square of the grid spacing */
+    float *u;               /* Solution (fine level) or correction */
+    float *f;               /* Right-hand side */
+    float *r;               /* Residual */
+} MG_LEVEL_t;
+
+/* The part of the team working on a step: a thread and its band of rows */
+typedef struct mg_team_s {
+    int tid;
+    int num_threads;
+    pthread_barrier_t *barrier;     /* NULL when a single thread works alone */
+} MG_TEAM_t;
+
+/* Structure that holds the arguments for the multigrid threads */
+typedef struct mg_args_s {
+    MG_TEAM_t team;
+    MG_LEVEL_t *level;
+    int num_levels;
+    int gamma;              /* 1 for V-cycles, 2 for W-cycles */
+    double *diff;           /* One partial diff per thread */
+    int *num_cycles;
+} MG_ARGS_t;
+
+void * multigrid_worker (void *);
+void mg_cycle (MG_LEVEL_t *, int, int, int, MG_TEAM_t *);
+void mg_smooth (MG_LEVEL_t *, int, MG_TEAM_t *);
+double mg_residual (MG_LEVEL_t *, MG_TEAM_t *);
+void mg_restrict (MG_LEVEL_t *, MG_LEVEL_t *, MG_TEAM_t *);
+void mg_prolong (MG_LEVEL_t *, MG_LEVEL_t *, MG_TEAM_t *);
+
+/* Wait for the rest of the team, if there is one. */
+static void
+mg_sync (MG_TEAM_t *team)
+{
+    if (team->barrier != NULL)
+        pthread_barrier_wait (team->barrier);
+}
+
+/* Rows [*start, *end) out of [first, last) that belong to this thread. */
+static void
+mg_rows (MG_TEAM_t *team, int first, int last, int *start, int *end)
+{
+    int n = last - first;
+    *start = first + (int) ((long) team->tid * n / team->num_threads);
+    *end = first + (int) ((long) (team->tid + 1) * n / team->num_threads);
+}
+
+/*------------------------------------------------------------------
+ * Function:    compute_using_multigrid
+ * Purpose:     Solve the grid in place with multigrid cycles
+ *
+ * Input args:  grid, num_threads, gamma (1 = V-cycle, 2 = W-cycle)
+ * Output args: num_cycles
+ * Return val:  grid
+ */  /*  */
+grid_t *
+compute_using_multigrid (grid_t *grid, int num_threads, int gamma, int *num_cycles)
+{
+    int i, l;
+    pthread_barrier_t barrier;
+
+    if (num_threads < 1)
+        num_threads = 1;
+
+    /* Build the hierarchy, halving the dimension on every level */
+    int num_levels = 1;
+    int dim = grid->dim;
+    while (dim > MG_COARSEST_DIM) {
+        dim = dim/2 + 1;
+        num_levels++;
+    }
+
+    MG_LEVEL_t *level = (MG_LEVEL_t *) malloc (num_levels * sizeof (MG_LEVEL_t));
+    if (level == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    dim = grid->dim;
+    for (l = 0; l < num_levels; l++) {
+        size_t size = (size_t) dim * dim * sizeof (float);
+        double h = (double) (grid->dim - 1)/(dim - 1);
+
+        level[l].dim = dim;
+        level[l].h2 = h * h;
+        level[l].u = (l == 0) ? grid->element : (float *) malloc (size);
+        level[l].f = (float *) malloc (size);
+        level[l].r = (float *) malloc (size);
+        if (level[l].u == NULL || level[l].f == NULL || level[l].r == NULL) {
+            perror ("malloc");
+            exit (EXIT_FAILURE);
+        }
+        if (l > 0)
+            memset (level[l].u, 0, size);
+        memset (level[l].f, 0, size);
+        memset (level[l].r, 0, size);
+        dim = dim/2 + 1;
+    }
+    printf ("Multigrid with %d levels, finest %d x %d, coarsest %d x %d\n", num_levels,
+            level[0].dim, level[0].dim, level[num_levels - 1].dim, level[num_levels - 1].dim);
+
+    pthread_t *worker_thread = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+    MG_ARGS_t *args_for_thread = (MG_ARGS_t *) malloc (num_threads * sizeof (MG_ARGS_t));
+    double *diff = (double *) malloc (num_threads * sizeof (double));
+    if (worker_thread == NULL || args_for_thread == NULL || diff == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    pthread_barrier_init (&barrier, NULL, num_threads);
+    for (i = 0; i < num_threads; i++) {
+        args_for_thread[i].team.tid = i;
+        args_for_thread[i].team.num_threads = num_threads;
+        args_for_thread[i].team.barrier = &barrier;
+        args_for_thread[i].level = level;
+        args_for_thread[i].num_levels = num_levels;
+        args_for_thread[i].gamma = gamma;
+        args_for_thread[i].diff = diff;
+        args_for_thread[i].num_cycles = num_cycles;
+
+        if ((create_solver_thread (&worker_thread[i], i, num_threads, multigrid_worker, (void *)&args_for_thread[i])) != 0) {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < num_threads; i++)
+        pthread_join (worker_thread[i], NULL);
+
+    pthread_barrier_destroy (&barrier);
+    for (l = 0; l < num_levels; l++) {
+        if (l > 0)
+            free ((void *) level[l].u);
+        free ((void *) level[l].f);
+        free ((void *) level[l].r);
+    }
+    free ((void *) level);
+    free ((void *) worker_thread);
+    free ((void *) args_for_thread);
+    free ((void *) diff);
+    return grid;
+}
+
+/*------------------------------------------------------------------
+ * Function:    multigrid_worker
+ * Purpose:     Run cycles until the fine grid converges. Every thread sums
+ *              the partial diffs in the same order, so they all reach the
+ *              same decision without an extra barrier
+ *
+ * Input args:  this_arg (thread argument structure)
+ * Return val:  NULL
+ */  /*  */
+void *
+multigrid_worker (void *this_arg)
+{
+    MG_ARGS_t *args_for_me = (MG_ARGS_t *) this_arg;
+    MG_TEAM_t *team = &args_for_me->team;
+    MG_LEVEL_t *fine = &args_for_me->level[0];
+    double num_elements = (double) (fine->dim - 2) * (fine->dim - 2);
+    float eps = 1e-6;
+    int cycles = 0;
+    int i;
+
+    for (;;) {
+        mg_cycle (args_for_me->level, 0, args_for_me->num_levels, args_for_me->gamma, team);
+
+        args_for_me->diff[team->tid] = mg_residual (fine, team);
+        mg_sync (team);
+        double test = 0.0;
+        for (i = 0; i < team->num_threads; i++)
+            test += args_for_me->diff[i];
+        test = 0.25 * test/num_elements;
+
+        cycles++;
+        if (team->tid == 0)
+            printf ("Cycle: %d - DIFF: %f\n", cycles, test);
+        if (test < eps)
+            break;
+    }
+
+    if (team->tid == 0)
+        *args_for_me->num_cycles = cycles;
+    return NULL;
+}
+
+/*------------------------------------------------------------------
+ * Function:    mg_cycle
+ * Purpose:     One V-cycle (gamma = 1) or W-cycle (gamma = 2) starting at
+ *              level l. Must be called by the whole team
+ *
+ * Input args:  level, l, num_levels, gamma, team
+ * Return val:  none
+ */  /*  */
+void
+mg_cycle (MG_LEVEL_t *level, int l, int num_levels, int gamma, MG_TEAM_t *team)
+{
+    int k;
+
+    /* Small levels are not worth splitting, thread 0 does the rest of the cycle */
+    if (team->barrier != NULL && level[l].dim < MG_PARALLEL_DIM) {
+        if (team->tid == 0) {
+            MG_TEAM_t alone = {0, 1, NULL};
+            mg_cycle (level, l, num_levels, gamma, &alone);
+        }
+        mg_sync (team);
+        return;
+    }
+
+    if (l == num_levels - 1) {
+        for (k = 0; k < MG_COARSEST_SWEEPS; k++)
+            mg_smooth (&level[l], 1, team);
+        return;
+    }
+
+    mg_smooth (&level[l], MG_PRE_SMOOTH, team);
+    mg_residual (&level[l], team);
+    mg_sync (team);
+    mg_restrict (&level[l], &level[l + 1], team);
+    mg_sync (team);
+
+    for (k = 0; k < gamma; k++)
+        mg_cycle (level, l + 1, num_levels, gamma, team);
+
+    mg_prolong (&level[l + 1], &level[l], team);
+    mg_sync (team);
+    mg_smooth (&level[l], MG_POST_SMOOTH, team);
+}
+
+/*------------------------------------------------------------------
+ * Function:    mg_smooth
+ * Purpose:     Red-black Gauss-Seidel sweeps on one level,
+ *              u = 0.25 * (N + S + E + W + h^2 f)
+ *
+ * Input args:  lv, sweeps, team
+ * Return val:  none
+ */  /*  */
+void
+mg_smooth (MG_LEVEL_t *lv, int sweeps, MG_TEAM_t *team)
+{
+    int dim = lv->dim;
+    float h2 = lv->h2;
+    int start, end, i, j, k, colour;
+
+    mg_rows (team, 1, dim - 1, &start, &end);
+    for (k = 0; k < sweeps; k++) {
+        for (colour = 0; colour < 2; colour++) {
+            for (i = start; i < end; i++) {
+                float *u = lv->u + (long) i * dim;
+                float *f = lv->f + (long) i * dim;
+                for (j = ((i + colour) % 2 == 0) ? 2 : 1; j < dim - 1; j += 2)
+                    u[j] = 0.25 * (u[j - dim] + u[j + dim] + u[j + 1] + u[j - 1] + h2 * f[j]);
+            }
+            mg_sync (team);
+        }
+    }
+}
+
+/*------------------------------------------------------------------
+ * Function:    mg_residual
+ * Purpose:     r = f + lap(u) on the thread's rows of one level
+ *
+ * Input args:  lv, team
+ * Return val:  sum of |r| * h^2 over the thread's rows
+ */  /*  */
+double
+mg_residual (MG_LEVEL_t *lv, MG_TEAM_t *team)
+{
+    int dim = lv->dim;
+    float inv_h2 = 1.0/lv->h2;
+    double sum = 0.0;
+    int start, end, i, j;
+
+    mg_rows (team, 1, dim - 1, &start, &end);
+    for (i = start; i < end; i++) {
+        float *u = lv->u + (long) i * dim;
+        float *f = lv->f + (long) i * dim;
+        float *r = lv->r + (long) i * dim;
+        for (j = 1; j < dim - 1; j++) {
+            r[j] = f[j] + inv_h2 * (u[j - dim] + u[j + dim] + u[j + 1] + u[j - 1] - 4.0f * u[j]);
+            sum += fabs (r[j]);
+        }
+    }
+    return sum * lv->h2;
+}
+
+/*------------------------------------------------------------------
+ * Function:    mg_restrict
+ * Purpose:     Move the residual of the fine level to the right-hand side
+ *              of the coarse level with the transpose of bilinear
+ *              interpolation (full weighting when the grids nest), and
+ *              clear the coarse correction
+ *
+ * Input args:  fine, coarse, team
+ * Return val:  none
+ */  /*  */
+void
+mg_restrict (MG_LEVEL_t *fine, MG_LEVEL_t *coarse, MG_TEAM_t *team)
+{
+    int fd = fine->dim, cd = coarse->dim;
+    double s = (double) (cd - 1)/(fd - 1);     /* coarse units per fine point */
+    int start, end, I, J, i, j;
+
+    mg_rows (team, 1, cd - 1, &start, &end);
+    for (I = start; I < end; I++) {
+        /* fine rows within one coarse spacing of row I */
+        int i_lo = (int) floor ((I - 1)/s) + 1;
+        int i_hi = (int) ceil ((I + 1)/s) - 1;
+        if (i_lo < 1)
+            i_lo = 1;
+        if (i_hi > fd - 2)
+            i_hi = fd - 2;
+
+        for (J = 1; J < cd - 1; J++) {
+            int j_lo = (int) floor ((J - 1)/s) + 1;
+            int j_hi = (int) ceil ((J + 1)/s) - 1;
+            if (j_lo < 1)
+                j_lo = 1;
+            if (j_hi > fd - 2)
+                j_hi = fd - 2;
+
+            double sum = 0.0;
+            for (i = i_lo; i <= i_hi; i++) {
+                double wi = 1.0 - fabs (i * s - I);
+                if (wi <= 0.0)
+                    continue;
+                for (j = j_lo; j <= j_hi; j++) {
+                    double wj = 1.0 - fabs (j * s - J);
+                    if (wj > 0.0)
+                        sum += wi * wj * fine->r[(long) i * fd + j];
+                }
+            }
+            coarse->f[(long) I * cd + J] = s * s * sum;
+            coarse->u[(long) I * cd + J] = 0.0;
+        }
+    }
+}
+
+/*------------------------------------------------------------------
+ * Function:    mg_prolong
+ * Purpose:     Interpolate the coarse correction bilinearly and add it to
+ *              the fine level
+ *
+ * Input args:  coarse, fine, team
+ * Return val:  none
+ */  /*  */
+void
+mg_prolong (MG_LEVEL_t *coarse, MG_LEVEL_t *fine, MG_TEAM_t *team)
+{
+    int fd = fine->dim, cd = coarse->dim;
+    double s = (double) (cd - 1)/(fd - 1);
+    int start, end, i, j;
+
+    mg_rows (team, 1, fd - 1, &start, &end);
+    for (i = start; i < end; i++) {
+        double x = i * s;
+        int I = (int) x;
+        double fx = x - I;
+        if (I >= cd - 1) {
+            I = cd - 2;
+            fx = 1.0;
+        }
+        float *e0 = coarse->u + (long) I * cd;
+        float *e1 = e0 + cd;
+
+        for (j = 1; j < fd - 1; j++) {
+            double y = j * s;
+            int J = (int) y;
+            double fy = y - J;
+            if (J >= cd - 1) {
+                J = cd - 2;
+                fy = 1.0;
+            }
+            fine->u[(long) i * fd + j] += (1.0 - fx) * ((1.0 - fy) * e0[J] + fy * e0[J + 1]) +
+                                   fx * ((1.0 - fy) * e1[J] + fy * e1[J + 1]);
+        }
+    }
+}
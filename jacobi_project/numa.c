@@ -0,0 +1,327 @@
+/* NUMA placement for the solver threads and grids.
+ *
+ * Linux places a page on the node of the CPU that first writes it. When main
+ * allocates and fills the grids, every page lands on main's node and on a
+ * multi-socket machine the workers of the other sockets stream their rows
+ * from remote memory. copy_grid_first_touch instead lets one thread per row
+ * band write the band, from the CPU the solver thread of that band will run
+ * on, so each band is local to the thread that sweeps it.
+ *
+ * With pin_threads set, create_solver_thread binds thread tid to a fixed CPU.
+ * Threads are spread evenly over the nodes, consecutive threads (which own
+ * neighbouring bands) on the same node. The node of a CPU is read from sysfs
+ * so libnuma is not needed.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "grid.h"
+
+#define MAX_NODES 64
+
+/* Structure that holds the arguments for the first-touch threads */
+typedef struct touch_args_s {
+    int tid;                /* Thread ID */
+    int num_threads;
+    int cyclic;             /* Rows go to the threads cyclically instead of in bands */
+    grid_t *src;
+    grid_t *dst;
+} TOUCH_ARGS_t;
+
+int pin_threads = 0;        /* Bind solver thread tid to thread_cpu (tid) */
+int first_touch = 0;        /* Let the solver threads first-touch their rows */
+
+static int num_cpus;        /* CPUs this process may run on */
+static int *cpu_list;       /* Those CPUs sorted by node */
+static int *cpu_node_of;    /* Node of cpu_list[k] */
+static int num_nodes;
+static int node_first[MAX_NODES + 1];  /* cpu_list[node_first[n] .. node_first[n+1]) are on node n */
+
+void * touch_worker (void *);
+
+/*------------------------------------------------------------------
+ * Function:    cpu_node
+ * Purpose:     Find the NUMA node of a CPU from the nodeN link sysfs puts
+ *              in the CPU's directory
+ *
+ * Input args:  cpu
+ * Return val:  node, 0 if the system does not report one
+ */  /*  */
+int
+cpu_node (int cpu)
+{
+    char path[64];
+    struct dirent *entry;
+    int node = 0;
+
+    snprintf (path, sizeof (path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir (path);
+    if (dir == NULL)
+        return 0;
+    while ((entry = readdir (dir)) != NULL) {
+        if (strncmp (entry->d_name, "node", 4) == 0 && sscanf (entry->d_name + 4, "%d", &node) == 1)
+            break;
+    }
+    closedir (dir);
+    return (node >= 0 && node < MAX_NODES) ? node : 0;
+}
+
+/* Build cpu_list from the affinity mask of the process, grouped by node. */
+static void
+numa_init (void)
+{
+    cpu_set_t mask;
+    int cpu, n, k;
+
+    if (cpu_list != NULL)
+        return;
+    if (sched_getaffinity (0, sizeof (mask), &mask) != 0)
+        CPU_ZERO (&mask);
+    if (CPU_COUNT (&mask) == 0)
+        CPU_SET (0, &mask);
+
+    num_cpus = CPU_COUNT (&mask);
+    cpu_list = (int *) malloc (num_cpus * sizeof (int));
+    cpu_node_of = (int *) malloc (num_cpus * sizeof (int));
+    if (cpu_list == NULL || cpu_node_of == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    int *node = (int *) malloc (CPU_SETSIZE * sizeof (int));
+    num_nodes = 1;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET (cpu, &mask))
+            continue;
+        node[cpu] = cpu_node (cpu);
+        if (node[cpu] + 1 > num_nodes)
+            num_nodes = node[cpu] + 1;
+    }
+
+    /* counting sort of the CPUs by node keeps them in id order within a node */
+    k = 0;
+    for (n = 0; n < num_nodes; n++) {
+        node_first[n] = k;
+        for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET (cpu, &mask) && node[cpu] == n) {
+                cpu_list[k] = cpu;
+                cpu_node_of[k] = n;
+                k++;
+            }
+        }
+    }
+    node_first[num_nodes] = k;
+    free ((void *) node);
+}
+
+/*------------------------------------------------------------------
+ * Function:    thread_cpu
+ * Purpose:     Pick the CPU solver thread tid is pinned to. The threads are
+ *              split evenly over the nodes that have CPUs, thread tid going
+ *              to the (tid * nodes / num_threads)-th of them, and take the
+ *              CPUs of their node in turn
+ *
+ * Input args:  tid, num_threads
+ * Return val:  index into cpu_list
+ */  /*  */
+static int
+thread_cpu (int tid, int num_threads)
+{
+    int used[MAX_NODES];
+    int num_used = 0;
+    int n;
+
+    numa_init ();
+    for (n = 0; n < num_nodes; n++)
+        if (node_first[n + 1] > node_first[n])
+            used[num_used++] = n;
+
+    /* threads of the node are [first, last), tid is the rank-th of them */
+    int slot = (int) ((long) tid * num_used / num_threads);
+    int first = (int) (((long) slot * num_threads + num_used - 1) / num_used);
+    int rank = tid - first;
+    n = used[slot];
+    int cpus = node_first[n + 1] - node_first[n];
+    return node_first[n] + rank % cpus;
+}
+
+/*------------------------------------------------------------------
+ * Function:    create_solver_thread
+ * Purpose:     pthread_create for the solver engines. With pin_threads the
+ *              thread starts bound to the CPU thread_cpu picks for tid
+ *
+ * Input args:  thread, tid, num_threads, start_routine, arg
+ * Return val:  result of pthread_create
+ */  /*  */
+int
+create_solver_thread (pthread_t *thread, int tid, int num_threads, void *(*start_routine) (void *), void *arg)
+{
+    pthread_attr_t attributes;
+    cpu_set_t mask;
+    int status;
+
+    if (!pin_threads)
+        return pthread_create (thread, NULL, start_routine, arg);
+
+    int k = thread_cpu (tid, num_threads);
+    CPU_ZERO (&mask);
+    CPU_SET (cpu_list[k], &mask);
+    pthread_attr_init (&attributes);
+    pthread_attr_setaffinity_np (&attributes, sizeof (mask), &mask);
+    status = pthread_create (thread, &attributes, start_routine, arg);
+    pthread_attr_destroy (&attributes);
+    return status;
+}
+
+/*------------------------------------------------------------------
+ * Function:    copy_grid_first_touch
+ * Purpose:     Same as copy_grid, but the new element array is written by
+ *              num_threads threads placed like the solver threads, so its
+ *              pages are placed on the node of the thread that owns the rows.
+ *              With cyclic, row i belongs to thread (i - 1) % num_threads as in
+ *              DECOMP_CYCLIC, otherwise the rows are split in contiguous bands
+ *
+ * Input args:  grid, num_threads, cyclic
+ * Return val:  new grid, NULL if it cannot be allocated
+ */  /*  */
+grid_t *
+copy_grid_first_touch (grid_t *grid, int num_threads, int cyclic)
+{
+    int i;
+
+    grid_t *new_grid = (grid_t *) malloc (sizeof (grid_t));
+    if (new_grid == NULL)
+        return NULL;
+    new_grid->dim = grid->dim;
+
+    /* page aligned and not written here, so no page is placed before the threads touch it */
+    long page = sysconf (_SC_PAGESIZE);
+    size_t size = sizeof (float) * new_grid->dim * new_grid->dim;
+    new_grid->element = (float *) aligned_alloc (page, (size + page - 1) / page * page);
+    if (new_grid->element == NULL)
+        return NULL;
+
+    if (num_threads < 1)
+        num_threads = 1;
+    pthread_t *worker_thread = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+    TOUCH_ARGS_t *args_for_thread = (TOUCH_ARGS_t *) malloc (num_threads * sizeof (TOUCH_ARGS_t));
+    if (worker_thread == NULL || args_for_thread == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    for (i = 0; i < num_threads; i++) {
+        args_for_thread[i].tid = i;
+        args_for_thread[i].num_threads = num_threads;
+        args_for_thread[i].cyclic = cyclic;
+        args_for_thread[i].src = grid;
+        args_for_thread[i].dst = new_grid;
+
+        if ((create_solver_thread (&worker_thread[i], i, num_threads, touch_worker, (void *)&args_for_thread[i])) != 0) {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < num_threads; i++)
+        pthread_join (worker_thread[i], NULL);
+
+    free ((void *) worker_thread);
+    free ((void *) args_for_thread);
+    return new_grid;
+}
+
+/* Copy the rows thread tid will own, the boundary rows go with the first and last band. */
+void *
+touch_worker (void *this_arg)
+{
+    TOUCH_ARGS_t *args_for_me = (TOUCH_ARGS_t *) this_arg;
+    int dim = args_for_me->src->dim;
+    int tid = args_for_me->tid;
+    int num_threads = args_for_me->num_threads;
+    int num_rows = dim - 2;
+    int i;
+
+    if (args_for_me->cyclic) {
+        for (i = 1 + tid; i < dim - 1; i += num_threads)
+            memcpy (&args_for_me->dst->element[i * dim], &args_for_me->src->element[i * dim], dim * sizeof (float));
+        if (tid == 0) {
+            memcpy (args_for_me->dst->element, args_for_me->src->element, dim * sizeof (float));
+            memcpy (&args_for_me->dst->element[(dim - 1) * dim], &args_for_me->src->element[(dim - 1) * dim], dim * sizeof (float));
+        }
+        return NULL;
+    }
+
+    int row_start = 1 + (int) ((long) tid * num_rows / num_threads);
+    int row_end = 1 + (int) ((long) (tid + 1) * num_rows / num_threads);
+    if (tid == 0)
+        row_start = 0;
+    if (tid == num_threads - 1)
+        row_end = dim;
+    memcpy (&args_for_me->dst->element[row_start * dim], &args_for_me->src->element[row_start * dim],
+            (size_t) (row_end - row_start) * dim * sizeof (float));
+    return NULL;
+}
+
+/* Node holding the page at addr, -1 if the kernel does not say. */
+static int
+page_node (void *addr)
+{
+    void *pages[1];
+    int status[1] = {-1};
+
+    pages[0] = (void *) ((unsigned long) addr & ~((unsigned long) sysconf (_SC_PAGESIZE) - 1));
+    /* move_pages with no target nodes only reports where the pages are */
+    if (syscall (SYS_move_pages, 0, 1UL, pages, NULL, status, 0) != 0)
+        return -1;
+    return status[0];
+}
+
+/*------------------------------------------------------------------
+ * Function:    print_thread_layout
+ * Purpose:     Print the CPU and node of every solver thread, and the node
+ *              the first and last page of its rows actually landed on. The
+ *              rows are split like copy_grid_first_touch splits them
+ *
+ * Input args:  grid, num_threads, cyclic
+ * Return val:  none
+ */  /*  */
+void
+print_thread_layout (grid_t *grid, int num_threads, int cyclic)
+{
+    int dim = grid->dim;
+    int num_rows = dim - 2;
+    int tid;
+
+    numa_init ();
+    printf ("Thread layout: %d CPUs on %d node(s), threads %s, grids %s\n", num_cpus, num_nodes,
+            pin_threads ? "pinned" : "not pinned", first_touch ? "first-touched by the threads" : "written by main");
+    for (tid = 0; tid < num_threads; tid++) {
+        int row_start = 1 + (int) ((long) tid * num_rows / num_threads);
+        int row_end = 1 + (int) ((long) (tid + 1) * num_rows / num_threads);
+        if (pin_threads) {
+            int k = thread_cpu (tid, num_threads);
+            printf ("  thread %d: CPU %d, node %d", tid, cpu_list[k], cpu_node_of[k]);
+        } else {
+            printf ("  thread %d: any CPU", tid);
+        }
+        if (cyclic && 1 + tid < dim - 1) {
+            int last = 1 + tid + (dim - 3 - tid) / num_threads * num_threads;
+            printf (", every %d-th row from %d to %d on node %d..%d\n", num_threads, 1 + tid, last,
+                    page_node (&grid->element[(1 + tid) * dim]), page_node (&grid->element[last * dim]));
+        } else if (!cyclic && row_end > row_start)
+            printf (", rows %d-%d on node %d..%d\n", row_start, row_end - 1,
+                    page_node (&grid->element[row_start * dim]), page_node (&grid->element[row_end * dim - 1]));
+        else
+            printf (", no rows\n");
+    }
+}
@@ -0,0 +1,258 @@
+/* Out-of-core Jacobi solver on memory-mapped grids.
+ *
+ * The other solvers keep two dim x dim float arrays in memory, which caps
+ * dim at what fits in RAM twice. Here both grids live in files that are
+ * mapped with mmap, so a grid_t can be larger than physical memory and the
+ * kernel pages it in and out as needed.
+ *
+ * Random faults would make that slow, so every iteration walks the grid
+ * from north to south in bands of rows. All threads work on the same band,
+ * each taking a slice of its rows, so the files are read and written in
+ * order. Before a band starts, thread 0 asks the kernel to read
+ * the next band ahead (MADV_WILLNEED), starts the write-back of the band
+ * just written (MS_ASYNC), and lets the kernel drop the pages of bands the
+ * sweep has left behind (MADV_DONTNEED), so the page cache holds little
+ * more than the bands in flight.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "grid.h"
+
+#define OOC_BAND_BYTES (32L << 20)  /* Rows per band are picked so a band of one grid is about this big */
+#define OOC_MIN_BAND 16             /* ... but never fewer rows than this */
+
+/* Structure that holds the arguments for the out-of-core threads */
+typedef struct ooc_args_s {
+    int tid;                /* Thread ID */
+    int num_threads;
+    int band_rows;
+    grid_t *grid_0;
+    grid_t *grid_1;
+    double *diff;           /* One partial diff per thread */
+    int *num_iter;
+    int *done;
+    pthread_barrier_t *barrier;
+} OOC_ARGS_t;
+
+void * ooc_worker (void *);
+
+/*------------------------------------------------------------------
+ * Function:    map_grid
+ * Purpose:     Create (or truncate) the file path, size it for a dim x dim
+ *              grid and map it. A new file is all zeros without being
+ *              written, so only the boundary needs to be set
+ *
+ * Input args:  path, dim
+ * Return val:  grid backed by the file, NULL on error
+ */  /*  */
+grid_t *
+map_grid (const char *path, int dim)
+{
+    size_t size = sizeof (float) * (size_t) dim * dim;
+
+    grid_t *grid = (grid_t *) malloc (sizeof (grid_t));
+    if (grid == NULL)
+        return NULL;
+    grid->dim = dim;
+
+    int fd = open (path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror (path);
+        free ((void *) grid);
+        return NULL;
+    }
+    if (ftruncate (fd, size) != 0) {
+        perror ("ftruncate");
+        close (fd);
+        free ((void *) grid);
+        return NULL;
+    }
+    grid->element = (float *) mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);     /* the mapping keeps the file open */
+    if (grid->element == MAP_FAILED) {
+        perror ("mmap");
+        free ((void *) grid);
+        return NULL;
+    }
+    madvise (grid->element, size, MADV_SEQUENTIAL);
+    return grid;
+}
+
+/* Flush a grid created by map_grid to its file and unmap it. */
+void
+unmap_grid (grid_t *grid)
+{
+    size_t size = sizeof (float) * (size_t) grid->dim * grid->dim;
+
+    msync (grid->element, size, MS_SYNC);
+    munmap (grid->element, size);
+    free ((void *) grid);
+}
+
+/* Apply a madvise hint, or an msync when advice is -1, to rows
+ * [first, last) of grid, widened to whole pages. */
+static void
+advise_rows (grid_t *grid, long first, long last, int advice)
+{
+    long page = sysconf (_SC_PAGESIZE);
+    long dim = grid->dim;
+
+    if (first < 0)
+        first = 0;
+    if (last > dim)
+        last = dim;
+    if (first >= last)
+        return;
+
+    unsigned long start = (unsigned long) &grid->element[first * dim] & ~(page - 1);
+    unsigned long end = (unsigned long) &grid->element[last * dim];
+    if (advice == -1)
+        msync ((void *) start, end - start, MS_ASYNC);
+    else
+        madvise ((void *) start, end - start, advice);
+}
+
+/*------------------------------------------------------------------
+ * Function:    compute_using_ooc_jacobi
+ * Purpose:     Solve the grid with the Jacobi method, streaming both mapped
+ *              grids through the stencil one band of rows at a time. grid_0
+ *              and grid_1 must hold the same initial conditions. Iteration
+ *              n reads grid_1 when n is even, like compute_using_pthreads_jacobi
+ *
+ * Input args:  grid_0, grid_1, num_threads, band_rows (0 = pick from dim)
+ * Output args: num_iter
+ * Return val:  grid holding the newest iteration
+ */  /*  */
+grid_t *
+compute_using_ooc_jacobi (grid_t *grid_0, grid_t *grid_1, int num_threads, int band_rows, int *num_iter)
+{
+    int dim = grid_0->dim;
+    int done = 0;
+    int i;
+    pthread_barrier_t barrier;
+
+    if (num_threads < 1)
+        num_threads = 1;
+    if (band_rows <= 0) {
+        band_rows = (int) (OOC_BAND_BYTES / ((long) dim * sizeof (float)));
+        if (band_rows < OOC_MIN_BAND)
+            band_rows = OOC_MIN_BAND;
+    }
+    if (band_rows > dim - 2)
+        band_rows = dim - 2;
+
+    pthread_t *worker_thread = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+    OOC_ARGS_t *args_for_thread = (OOC_ARGS_t *) malloc (num_threads * sizeof (OOC_ARGS_t));
+    double *diff = (double *) malloc (num_threads * sizeof (double));
+    if (worker_thread == NULL || args_for_thread == NULL || diff == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    printf ("Streaming bands of %d rows (%.1f MB per grid)\n", band_rows, (double) band_rows * dim * sizeof (float) / (1 << 20));
+    *num_iter = 0;
+    pthread_barrier_init (&barrier, NULL, num_threads);
+    for (i = 0; i < num_threads; i++) {
+        args_for_thread[i].tid = i;
+        args_for_thread[i].num_threads = num_threads;
+        args_for_thread[i].band_rows = band_rows;
+        args_for_thread[i].grid_0 = grid_0;
+        args_for_thread[i].grid_1 = grid_1;
+        args_for_thread[i].diff = diff;
+        args_for_thread[i].num_iter = num_iter;
+        args_for_thread[i].done = &done;
+        args_for_thread[i].barrier = &barrier;
+
+        if ((create_solver_thread (&worker_thread[i], i, num_threads, ooc_worker, (void *)&args_for_thread[i])) != 0) {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < num_threads; i++)
+        pthread_join (worker_thread[i], NULL);
+
+    pthread_barrier_destroy (&barrier);
+    free ((void *) worker_thread);
+    free ((void *) args_for_thread);
+    free ((void *) diff);
+
+    /* return newest grid value when convergence is achieved */
+    return (*num_iter % 2 == 1) ? grid_0 : grid_1;
+}
+
+/*------------------------------------------------------------------
+ * Function:    ooc_worker
+ * Purpose:     Sweep every band of the grid together with the other threads,
+ *              taking a slice of the band's rows. Thread 0 issues the paging
+ *              hints for each band, the serial thread of the final barrier
+ *              tests for convergence
+ *
+ * Input args:  this_arg (thread argument structure)
+ * Return val:  NULL
+ */  /*  */
+void *
+ooc_worker (void *this_arg)
+{
+    OOC_ARGS_t *args_for_me = (OOC_ARGS_t *) this_arg;
+    int dim = args_for_me->grid_0->dim;
+    int tid = args_for_me->tid;
+    int num_threads = args_for_me->num_threads;
+    int band_rows = args_for_me->band_rows;
+    float eps = 1e-6;
+    int n = 0;
+    int i;
+
+    while (!*args_for_me->done) {
+        grid_t *read_grid = (n % 2 == 1) ? args_for_me->grid_0 : args_for_me->grid_1;
+        grid_t *write_grid = (n % 2 == 1) ? args_for_me->grid_1 : args_for_me->grid_0;
+        double diff = 0.0;
+        int band;
+
+        /* Jacobi only reads read_grid, so the threads need not wait for each other between bands */
+        for (band = 1; band < dim - 1; band += band_rows) {
+            int band_end = (band + band_rows < dim - 1) ? band + band_rows : dim - 1;
+
+            if (tid == 0) {
+                /* rows band_end .. band_end + band_rows are read next, plus the row below them */
+                advise_rows (read_grid, band_end, band_end + band_rows + 1, MADV_WILLNEED);
+                advise_rows (write_grid, band_end, band_end + band_rows, MADV_WILLNEED);
+                /* the band before this one is final for this iteration */
+                advise_rows (write_grid, band - band_rows, band, -1);
+                /* and the one before that is not read again until the next iteration */
+                advise_rows (read_grid, band - 2 * band_rows - 1, band - band_rows - 1, MADV_DONTNEED);
+            }
+
+            int rows = band_end - band;
+            int row_start = band + (int) ((long) tid * rows / num_threads);
+            int row_end = band + (int) ((long) (tid + 1) * rows / num_threads);
+            for (i = row_start; i < row_end; i++)
+                diff += jacobi_row (read_grid->element, write_grid->element, dim, i, 1, dim - 1);
+        }
+        args_for_me->diff[tid] = diff;
+
+        if (pthread_barrier_wait (args_for_me->barrier) == PTHREAD_BARRIER_SERIAL_THREAD) {
+            double test = 0.0;
+            for (i = 0; i < num_threads; i++)
+                test += args_for_me->diff[i];
+            test = test/((double) (dim - 2) * (dim - 2));
+
+            (*args_for_me->num_iter)++;
+            printf ("Iteration: %d - DIFF: %f\n", *args_for_me->num_iter, test);
+            if (test < eps)
+                *args_for_me->done = 1;
+        }
+        pthread_barrier_wait (args_for_me->barrier);    /* everyone sees done */
+        n++;
+    }
+    return NULL;
+}
@@ -0,0 +1,297 @@
+/* Per-thread phase profile of the threaded jacobi solvers.
+ *
+ * With profiling on, every solver thread records for each iteration when it
+ * started, when its sweep was done and when it was released to start the
+ * next one. Time between release and the end of the sweep is compute; the
+ * rest is wait: at the barrier for the pool, in thread creation and at the
+ * join for compute_using_pthreads_jacobi. Where perf_event_open is allowed
+ * (see /proc/sys/kernel/perf_event_paranoid) each thread also counts cycles,
+ * instructions and last level cache read misses in user mode. The counters
+ * are read around the sweep only, so they describe the compute phase.
+ *
+ * profile_stop prints a per-thread summary and the spread of iteration
+ * times, and writes one line per thread and iteration to a trace file.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "grid.h"
+
+#define NUM_COUNTERS 3      /* cycles, instructions, LLC read misses */
+
+/* One iteration of one thread, in seconds since profile_start */
+typedef struct profile_event_s {
+    int num_iter;
+    double begin;           /* Released into the iteration */
+    double compute_end;     /* Sweep done */
+    double end;             /* Released into the next one */
+} PROFILE_EVENT_t;
+
+/* Everything one thread records, alone on its cache lines */
+typedef struct profile_thread_s {
+    double compute, wait;
+    double last_end;                /* end of the previous iteration */
+    double compute_begin;
+    long long count[NUM_COUNTERS];  /* Summed over the sweeps */
+    long long count_begin[NUM_COUNTERS];
+    int fd[NUM_COUNTERS];           /* -1 where the counter could not be opened */
+    PROFILE_EVENT_t *trace;
+    int trace_len, trace_size;
+} __attribute__ ((aligned (64))) PROFILE_THREAD_t;
+
+int profile_enabled = 0;    /* Set by profile_start, checked by the solvers before every hook */
+
+static PROFILE_THREAD_t *profile;
+static int profile_threads;
+static double profile_origin;
+static const char *counter_name[NUM_COUNTERS] = {"cycles", "instructions", "LLC misses"};
+
+/* Seconds since profile_start. */
+static double
+profile_clock (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9 - profile_origin;
+}
+
+/* Open one user mode counter of the calling thread, -1 if not allowed. */
+static int
+open_counter (int k)
+{
+    struct perf_event_attr attr;
+
+    memset (&attr, 0, sizeof (attr));
+    attr.size = sizeof (attr);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    if (k == 0) {
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    } else if (k == 1) {
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    } else {
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                      | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+    return (int) syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* Read the counters of a thread into values. */
+static void
+read_counters (PROFILE_THREAD_t *me, long long *values)
+{
+    for (int k = 0; k < NUM_COUNTERS; k++)
+        if (me->fd[k] < 0 || read (me->fd[k], &values[k], sizeof (long long)) != sizeof (long long))
+            values[k] = 0;
+}
+
+/*------------------------------------------------------------------
+ * Function:    profile_start
+ * Purpose:     Turn profiling on for the next solve with num_threads threads
+ *
+ * Input args:  num_threads
+ * Return val:  none
+ */  /*  */
+void
+profile_start (int num_threads)
+{
+    profile = (PROFILE_THREAD_t *) aligned_alloc (64, num_threads * sizeof (PROFILE_THREAD_t));
+    if (profile == NULL) {
+        perror ("aligned_alloc");
+        exit (EXIT_FAILURE);
+    }
+    memset (profile, 0, num_threads * sizeof (PROFILE_THREAD_t));
+    for (int i = 0; i < num_threads; i++)
+        for (int k = 0; k < NUM_COUNTERS; k++)
+            profile[i].fd[k] = -1;
+    profile_threads = num_threads;
+    profile_origin = 0.0;
+    profile_origin = profile_clock ();
+    profile_enabled = 1;
+}
+
+/* Called by solver thread tid when it starts: open its counters. */
+void
+profile_thread_enter (int tid)
+{
+    for (int k = 0; k < NUM_COUNTERS; k++)
+        profile[tid].fd[k] = open_counter (k);
+}
+
+/* Called by solver thread tid before it exits: close its counters. */
+void
+profile_thread_exit (int tid)
+{
+    for (int k = 0; k < NUM_COUNTERS; k++) {
+        if (profile[tid].fd[k] >= 0)
+            close (profile[tid].fd[k]);
+        profile[tid].fd[k] = -1;
+    }
+}
+
+/* Called by thread tid right before its sweep. */
+void
+profile_compute_begin (int tid)
+{
+    PROFILE_THREAD_t *me = &profile[tid];
+
+    read_counters (me, me->count_begin);
+    me->compute_begin = profile_clock ();
+}
+
+/*------------------------------------------------------------------
+ * Function:    profile_compute_end
+ * Purpose:     Called by thread tid right after its sweep of iteration
+ *              num_iter: add the counts and start a trace event
+ *
+ * Input args:  tid, num_iter
+ * Return val:  none
+ */  /*  */
+void
+profile_compute_end (int tid, int num_iter)
+{
+    PROFILE_THREAD_t *me = &profile[tid];
+    long long values[NUM_COUNTERS];
+    double t = profile_clock ();
+
+    read_counters (me, values);
+    for (int k = 0; k < NUM_COUNTERS; k++)
+        me->count[k] += values[k] - me->count_begin[k];
+
+    if (me->trace_len == me->trace_size) {
+        me->trace_size = (me->trace_size == 0) ? 1024 : 2 * me->trace_size;
+        me->trace = (PROFILE_EVENT_t *) realloc (me->trace, me->trace_size * sizeof (PROFILE_EVENT_t));
+        if (me->trace == NULL) {
+            perror ("realloc");
+            exit (EXIT_FAILURE);
+        }
+    }
+    PROFILE_EVENT_t *event = &me->trace[me->trace_len++];
+    event->num_iter = num_iter;
+    event->begin = me->last_end;
+    event->compute_end = t;
+    event->end = t;
+    me->compute += t - me->compute_begin;
+    me->wait += me->compute_begin - me->last_end;
+}
+
+/*------------------------------------------------------------------
+ * Function:    profile_wait_end
+ * Purpose:     Close the iteration thread tid is in: it may start the next
+ *              one. Called by the thread itself after the barrier, or by
+ *              the creating thread after the join
+ *
+ * Input args:  tid
+ * Return val:  none
+ */  /*  */
+void
+profile_wait_end (int tid)
+{
+    PROFILE_THREAD_t *me = &profile[tid];
+    double t = profile_clock ();
+
+    if (me->trace_len > 0) {
+        PROFILE_EVENT_t *event = &me->trace[me->trace_len - 1];
+        event->end = t;
+        me->wait += t - event->compute_end;
+    }
+    me->last_end = t;
+}
+
+static int
+compare_doubles (const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/*------------------------------------------------------------------
+ * Function:    profile_stop
+ * Purpose:     Turn profiling off, print the per-thread summary and the
+ *              iteration times, and write the trace to trace_path
+ *
+ * Input args:  trace_path
+ * Return val:  none
+ */  /*  */
+void
+profile_stop (const char *trace_path)
+{
+    int num_threads = profile_threads;
+    int num_events = profile[0].trace_len;
+    int have_counters = 0;
+    int i, k, n;
+
+    profile_enabled = 0;
+    for (i = 0; i < num_threads; i++) {
+        if (profile[i].trace_len < num_events)
+            num_events = profile[i].trace_len;
+        for (k = 0; k < NUM_COUNTERS; k++)
+            if (profile[i].count[k] != 0)
+                have_counters = 1;
+    }
+
+    printf ("\nPer-thread profile over %d iterations\n", num_events);
+    printf ("%6s %12s %12s %7s %14s %14s %6s %14s\n", "thread", "compute (s)", "wait (s)", "wait %",
+            counter_name[0], counter_name[1], "IPC", counter_name[2]);
+    for (i = 0; i < num_threads; i++) {
+        PROFILE_THREAD_t *me = &profile[i];
+        double total = me->compute + me->wait;
+        printf ("%6d %12f %12f %6.1f%%", i, me->compute, me->wait, (total > 0.0) ? 100.0 * me->wait/total : 0.0);
+        if (have_counters)
+            printf (" %14lld %14lld %6.2f %14lld\n", me->count[0], me->count[1],
+                    (me->count[0] > 0) ? (double) me->count[1]/me->count[0] : 0.0, me->count[2]);
+        else
+            printf (" %14s %14s %6s %14s\n", "n/a", "n/a", "n/a", "n/a");
+    }
+    if (!have_counters)
+        printf ("(hardware counters unavailable, see /proc/sys/kernel/perf_event_paranoid)\n");
+
+    /* an iteration lasts from the release of its first thread to the release of its last */
+    if (num_events > 0) {
+        double *iter_time = (double *) malloc (num_events * sizeof (double));
+        for (n = 0; n < num_events; n++) {
+            double begin = profile[0].trace[n].begin, end = profile[0].trace[n].end;
+            for (i = 1; i < num_threads; i++) {
+                if (profile[i].trace[n].begin < begin)
+                    begin = profile[i].trace[n].begin;
+                if (profile[i].trace[n].end > end)
+                    end = profile[i].trace[n].end;
+            }
+            iter_time[n] = end - begin;
+        }
+        qsort (iter_time, num_events, sizeof (double), compare_doubles);
+        printf ("Iteration time (s): min %f, median %f, p99 %f, max %f\n", iter_time[0],
+                iter_time[num_events / 2], iter_time[(int) (0.99 * (num_events - 1))], iter_time[num_events - 1]);
+        free ((void *) iter_time);
+    }
+
+    FILE *trace = fopen (trace_path, "w");
+    if (trace == NULL) {
+        perror (trace_path);
+    } else {
+        fprintf (trace, "iteration,thread,begin_s,compute_end_s,end_s\n");
+        for (n = 0; n < num_events; n++)
+            for (i = 0; i < num_threads; i++)
+                fprintf (trace, "%d,%d,%.9f,%.9f,%.9f\n", profile[i].trace[n].num_iter, i,
+                         profile[i].trace[n].begin, profile[i].trace[n].compute_end, profile[i].trace[n].end);
+        fclose (trace);
+        printf ("Trace written to %s\n", trace_path);
+    }
+
+    for (i = 0; i < num_threads; i++)
+        free ((void *) profile[i].trace);
+    free ((void *) profile);
+    profile = NULL;
+}
@@ -0,0 +1,203 @@
+/* Parallel red-black Gauss-Seidel solver.
+ *
+ * compute_gold sweeps the grid in place in row-major order, which makes
+ * every point depend on the one before it. Colouring the points like a
+ * checkerboard, red where i + j is even and black where it is odd, breaks
+ * that chain: a red point only has black neighbours and vice versa. Each
+ * iteration updates all red points from the black ones, then all black
+ * points from the new red ones, so the points of one colour can be updated
+ * in any order and split across threads. Convergence is as fast as
+ * Gauss-Seidel's.
+ *
+ * With omega > 1 the points are over-relaxed (red-black SOR), which cuts
+ * the iteration count by up to an order of magnitude. With OMEGA_ADAPT
+ * the serial thread estimates omega from the rate at which diff falls.
+ *
+ * The threads are created once, own a contiguous band of rows and meet at a
+ * barrier after every half sweep.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <math.h>
+#include "grid.h"
+
+/* Structure that holds the arguments for the red-black threads */
+typedef struct rb_args_s {
+    int tid;                /* Thread ID */
+    int num_threads;
+    grid_t *grid;
+    double *diff;           /* One partial diff per thread */
+    int *num_iter;
+    int *done;
+    float *omega;           /* Relaxation factor, changed only by the serial thread */
+    int adapt;              /* Estimate omega from the convergence rate */
+    SOR_ADAPT_t *adapt_state;
+    pthread_barrier_t *barrier;
+} RB_ARGS_t;
+
+void * redblack_worker (void *);
+
+/*------------------------------------------------------------------
+ * Function:    compute_using_redblack_gs
+ * Purpose:     Solve the grid in place with red-black Gauss-Seidel using
+ *              num_threads persistent threads, over-relaxed by omega
+ *              (1 for plain Gauss-Seidel, OMEGA_ADAPT to estimate it)
+ *
+ * Input args:  grid, num_threads, omega
+ * Output args: num_iter
+ * Return val:  grid
+ */  /*  */
+grid_t *
+compute_using_redblack_gs (grid_t *grid, int num_threads, float omega, int *num_iter)
+{
+    int i;
+    int done = 0;
+    pthread_barrier_t barrier;
+    SOR_ADAPT_t adapt_state = {0.0, 0.0, 0.0, 0};
+    float w = (omega == OMEGA_ADAPT) ? 1.0 : omega;
+
+    if (num_threads < 1)
+        num_threads = 1;
+    pthread_t *worker_thread = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+    RB_ARGS_t *args_for_thread = (RB_ARGS_t *) malloc (num_threads * sizeof (RB_ARGS_t));
+    double *diff = (double *) malloc (num_threads * sizeof (double));
+    if (worker_thread == NULL || args_for_thread == NULL || diff == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    *num_iter = 0;
+    pthread_barrier_init (&barrier, NULL, num_threads);
+    for (i = 0; i < num_threads; i++) {
+        args_for_thread[i].tid = i;
+        args_for_thread[i].num_threads = num_threads;
+        args_for_thread[i].grid = grid;
+        args_for_thread[i].diff = diff;
+        args_for_thread[i].num_iter = num_iter;
+        args_for_thread[i].done = &done;
+        args_for_thread[i].omega = &w;
+        args_for_thread[i].adapt = (omega == OMEGA_ADAPT);
+        args_for_thread[i].adapt_state = &adapt_state;
+        args_for_thread[i].barrier = &barrier;
+
+        if ((create_solver_thread (&worker_thread[i], i, num_threads, redblack_worker, (void *)&args_for_thread[i])) != 0) {
+            perror ("pthread_create");
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < num_threads; i++)
+        pthread_join (worker_thread[i], NULL);
+
+    pthread_barrier_destroy (&barrier);
+    free ((void *) worker_thread);
+    free ((void *) args_for_thread);
+    free ((void *) diff);
+    if (omega != 1.0)
+        printf ("Red-black SOR finished with omega = %f\n", w);
+    return grid;
+}
+
+/*------------------------------------------------------------------
+ * Function:    redblack_row
+ * Purpose:     Update, in place, the points of row i whose colour is
+ *              colour (0 red, 1 black), over-relaxed by omega
+ *
+ * Input args:  element, dim, i, colour, omega
+ * Return val:  sum of |new - old| over the updated points
+ */  /*  */
+double
+redblack_row (float *element, int dim, int i, int colour, float omega)
+{
+    float *up = element + (long) (i - 1) * dim;
+    float *row = element + (long) i * dim;
+    float *down = element + (long) (i + 1) * dim;
+    float old, new;
+    double diff = 0.0;
+    int j;
+
+    /* first column of the row that has the wanted colour */
+    j = ((i + colour) % 2 == 0) ? 2 : 1;
+    if (omega == 1.0) {
+        for (; j < dim - 1; j += 2) {
+            old = row[j];
+            new = 0.25 * (up[j] + down[j] + row[j + 1] + row[j - 1]);
+            row[j] = new;
+            diff = diff + fabs(new - old);
+        }
+    } else {
+        for (; j < dim - 1; j += 2) {
+            old = row[j];
+            /* in double, or the over-relaxed rounding error keeps diff above eps */
+            new = old + omega * (0.25 * ((double) up[j] + down[j] + row[j + 1] + row[j - 1]) - old);
+            row[j] = new;
+            diff = diff + fabs(new - old);
+        }
+    }
+    return diff;
+}
+
+/*------------------------------------------------------------------
+ * Function:    redblack_worker
+ * Purpose:     Sweep the red points of the thread's band, wait, sweep the
+ *              black points, wait, and let the serial thread test for
+ *              convergence before the next iteration starts
+ *
+ * Input args:  this_arg (thread argument structure)
+ * Return val:  NULL
+ */  /*  */
+void *
+redblack_worker (void *this_arg)
+{
+    RB_ARGS_t *args_for_me = (RB_ARGS_t *) this_arg;
+    grid_t *grid = args_for_me->grid;
+    int dim = grid->dim;
+    int tid = args_for_me->tid;
+    int num_threads = args_for_me->num_threads;
+    float eps = 1e-6;
+    int i;
+
+    /* rows [row_start, row_end) belong to this thread */
+    int num_rows = dim - 2;
+    int row_start = 1 + (int) ((long) tid * num_rows / num_threads);
+    int row_end = 1 + (int) ((long) (tid + 1) * num_rows / num_threads);
+
+    while (!*args_for_me->done) {
+        double diff = 0.0;
+        float omega = *args_for_me->omega;
+        for (i = row_start; i < row_end; i++)
+            diff += redblack_row (grid->element, dim, i, 0, omega);
+        pthread_barrier_wait (args_for_me->barrier);    /* red done, black may read it */
+
+        for (i = row_start; i < row_end; i++)
+            diff += redblack_row (grid->element, dim, i, 1, omega);
+        args_for_me->diff[tid] = diff;
+
+        if (pthread_barrier_wait (args_for_me->barrier) == PTHREAD_BARRIER_SERIAL_THREAD) {
+            double test = 0.0;
+            for (i = 0; i < num_threads; i++)
+                test += args_for_me->diff[i];
+            test = test/((double) num_rows * num_rows);
+
+            (*args_for_me->num_iter)++;
+            printf ("Iteration: %d - DIFF: %f\n", *args_for_me->num_iter, test);
+            if (test < eps)
+                *args_for_me->done = 1;
+
+            if (args_for_me->adapt) {
+                float estimate = sor_adapt (args_for_me->adapt_state, test, omega);
+                if (estimate > 0.0) {
+                    *args_for_me->omega = estimate;
+                    printf ("Switching to omega = %f\n", estimate);
+                }
+            }
+        }
+        pthread_barrier_wait (args_for_me->barrier);    /* everyone sees done and omega */
+    }
+    return NULL;
+}
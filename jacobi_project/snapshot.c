@@ -0,0 +1,259 @@
+/* Snapshots of the grid while it converges, written in the background.
+ *
+ * A snapshot file is a SNAP_HEADER_SIZE byte file header (magic, version,
+ * stencil dimensions, format) followed by one frame per snapshot. A frame
+ * is a SNAP_FRAME_SIZE byte header (iterations done, dim, diff) and the
+ * stencil_points (dim) values of the grid, either as floats or, with
+ * SNAPSHOT_BF16, as the upper 16 bits of each float, which halves the file
+ * and is plenty for plotting. Everything is in the byte order of the
+ * machine that wrote it.
+ *
+ * snapshot_post is called by the serial thread between sweeps, next to
+ * checkpoint_post. It copies the grid into a free slot and returns; the
+ * writer thread converts and appends the frames in order. If every slot is
+ * still waiting to be written the snapshot is skipped rather than stalling
+ * the solve. snapshot_grid queues a snapshot whenever it is called and waits
+ * for a slot if it must; main uses it for the grids it used to print under
+ * DEBUG.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "grid.h"
+
+#define SNAP_MAGIC "JACOBISN"
+#define SNAP_VERSION 1
+#define SNAP_HEADER_SIZE 32
+#define SNAP_FRAME_SIZE 16
+#define SNAP_SLOTS 2            /* Grids queued for the writer at most */
+
+/* What a snapshot file starts with, padded to SNAP_HEADER_SIZE */
+typedef struct snap_header_s {
+    char magic[8];
+    int version;
+    int ndim;               /* Grids hold dim^ndim values */
+    int format;             /* SNAPSHOT_F32 or SNAPSHOT_BF16 */
+} SNAP_HEADER_t;
+
+/* What every frame starts with */
+typedef struct snap_frame_s {
+    int num_iter;
+    int dim;
+    double diff;
+} SNAP_FRAME_t;
+
+/* A grid waiting for the writer */
+typedef struct snap_slot_s {
+    float *element;
+    SNAP_FRAME_t frame;
+} SNAP_SLOT_t;
+
+int snapshot_every = 0;                 /* Iterations between snapshots, 0 = off */
+
+static FILE *snap_file;
+static char *snap_path;
+static int snap_format;
+static size_t snap_points;              /* Values per grid */
+static SNAP_SLOT_t snap_slot[SNAP_SLOTS];
+static int snap_head, snap_count;       /* Slots snap_head .. snap_head + snap_count - 1 are queued */
+static int snap_quit, snap_started;
+static int last_snapshot, num_frames, num_dropped;
+static pthread_t snap_thread;
+static pthread_mutex_t snap_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t snap_cond = PTHREAD_COND_INITIALIZER;
+
+void * snapshot_writer (void *);
+
+/*------------------------------------------------------------------
+ * Function:    snapshot_start
+ * Purpose:     Create the snapshot file path for dim x dim (x dim) grids and
+ *              start the writer thread
+ *
+ * Input args:  path, dim, format (SNAPSHOT_F32 or SNAPSHOT_BF16)
+ * Return val:  none
+ */  /*  */
+void
+snapshot_start (const char *path, int dim, int format)
+{
+    char header[SNAP_HEADER_SIZE];
+    SNAP_HEADER_t h;
+
+    snap_file = fopen (path, "wb");
+    if (snap_file == NULL) {
+        perror (path);
+        exit (EXIT_FAILURE);
+    }
+    snap_path = strdup (path);
+    snap_format = format;
+    snap_points = stencil_points (dim);
+    for (int k = 0; k < SNAP_SLOTS; k++) {
+        snap_slot[k].element = (float *) malloc (sizeof (float) * snap_points);
+        if (snap_slot[k].element == NULL) {
+            perror ("malloc");
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    memset (header, 0, sizeof (header));
+    memcpy (h.magic, SNAP_MAGIC, 8);
+    h.version = SNAP_VERSION;
+    h.ndim = stencil->ndim;
+    h.format = format;
+    memcpy (header, &h, sizeof (h));
+    fwrite (header, 1, sizeof (header), snap_file);
+
+    snap_head = snap_count = 0;
+    snap_quit = 0;
+    last_snapshot = 0;
+    num_frames = num_dropped = 0;
+    if ((pthread_create (&snap_thread, NULL, snapshot_writer, NULL)) != 0) {
+        perror ("pthread_create");
+        exit (EXIT_FAILURE);
+    }
+    snap_started = 1;
+}
+
+/*------------------------------------------------------------------
+ * Function:    queue_snapshot
+ * Purpose:     Queue a copy of grid for the writer. Must be called while no
+ *              thread writes the grid; it returns as soon as the grid is
+ *              copied. If no slot is free it waits for one, or with wait
+ *              unset drops the snapshot
+ *
+ * Input args:  grid, num_iter, diff, wait
+ * Return val:  none
+ */  /*  */
+static void
+queue_snapshot (const grid_t *grid, int num_iter, double diff, int wait)
+{
+    if (!snap_started)
+        return;
+
+    pthread_mutex_lock (&snap_mutex);
+    while (wait && snap_count == SNAP_SLOTS)
+        pthread_cond_wait (&snap_cond, &snap_mutex);
+    if (snap_count == SNAP_SLOTS) {
+        num_dropped++;
+        pthread_mutex_unlock (&snap_mutex);
+        return;
+    }
+    SNAP_SLOT_t *slot = &snap_slot[(snap_head + snap_count) % SNAP_SLOTS];
+    pthread_mutex_unlock (&snap_mutex);
+
+    /* the slot past the queue is ours until it is queued */
+    memcpy (slot->element, grid->element, sizeof (float) * snap_points);
+    slot->frame.num_iter = num_iter;
+    slot->frame.dim = grid->dim;
+    slot->frame.diff = diff;
+
+    pthread_mutex_lock (&snap_mutex);
+    snap_count++;
+    pthread_cond_broadcast (&snap_cond);
+    pthread_mutex_unlock (&snap_mutex);
+}
+
+/* Queue the grid after num_iter iterations if a snapshot is due, drop it if the writer is behind. */
+void
+snapshot_post (const grid_t *grid, int num_iter, double diff)
+{
+    if (snapshot_every <= 0 || num_iter - last_snapshot < snapshot_every)
+        return;
+    last_snapshot = num_iter;
+    queue_snapshot (grid, num_iter, diff, 0);
+}
+
+/* Queue the grid whatever the interval, waiting for the writer if it is behind. */
+void
+snapshot_grid (const grid_t *grid, int num_iter, double diff)
+{
+    queue_snapshot (grid, num_iter, diff, 1);
+}
+
+/* Write the queued snapshots, stop the writer and report. */
+void
+snapshot_stop (void)
+{
+    if (!snap_started)
+        return;
+    pthread_mutex_lock (&snap_mutex);
+    snap_quit = 1;
+    pthread_cond_broadcast (&snap_cond);
+    pthread_mutex_unlock (&snap_mutex);
+    pthread_join (snap_thread, NULL);
+    snap_started = 0;
+
+    if (fclose (snap_file) != 0)
+        perror (snap_path);
+    printf ("Wrote %d snapshot(s) to %s, dropped %d while the writer was behind\n", num_frames, snap_path, num_dropped);
+    for (int k = 0; k < SNAP_SLOTS; k++)
+        free ((void *) snap_slot[k].element);
+    free ((void *) snap_path);
+}
+
+/*------------------------------------------------------------------
+ * Function:    snapshot_writer
+ * Purpose:     Body of the writer thread: append the queued grids to the
+ *              snapshot file in order, converting them to bf16 if asked
+ *
+ * Input args:  unused
+ * Return val:  NULL
+ */  /*  */
+void *
+snapshot_writer (void *unused)
+{
+    uint16_t *half = NULL;
+    size_t k;
+
+    if (snap_format == SNAPSHOT_BF16) {
+        half = (uint16_t *) malloc (sizeof (uint16_t) * snap_points);
+        if (half == NULL) {
+            perror ("malloc");
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    for (;;) {
+        pthread_mutex_lock (&snap_mutex);
+        while (snap_count == 0 && !snap_quit)
+            pthread_cond_wait (&snap_cond, &snap_mutex);
+        if (snap_count == 0) {
+            pthread_mutex_unlock (&snap_mutex);
+            break;
+        }
+        SNAP_SLOT_t *slot = &snap_slot[snap_head];
+        pthread_mutex_unlock (&snap_mutex);
+
+        int ok = (fwrite (&slot->frame, 1, SNAP_FRAME_SIZE, snap_file) == SNAP_FRAME_SIZE);
+        if (half != NULL) {
+            /* round to nearest even on the upper 16 bits */
+            for (k = 0; k < snap_points; k++) {
+                uint32_t bits;
+                memcpy (&bits, &slot->element[k], sizeof (bits));
+                half[k] = (uint16_t) ((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+            }
+            ok = ok && (fwrite (half, sizeof (uint16_t), snap_points, snap_file) == snap_points);
+        } else {
+            ok = ok && (fwrite (slot->element, sizeof (float), snap_points, snap_file) == snap_points);
+        }
+        if (ok)
+            num_frames++;
+        else
+            perror (snap_path);
+
+        pthread_mutex_lock (&snap_mutex);
+        snap_head = (snap_head + 1) % SNAP_SLOTS;
+        snap_count--;
+        pthread_cond_broadcast (&snap_cond);    /* a snapshot_grid may be waiting for the slot */
+        pthread_mutex_unlock (&snap_mutex);
+    }
+
+    free ((void *) half);
+    return NULL;
+}
@@ -3,13 +3,17 @@
  * Date modified: March 26, 2020
  *
  * Compile as follows:
- * gcc -o solver solver.c solver_gold.c -O3 -Wall -std=c99 -lm -lpthread
+ * gcc -o solver solver.c jacobi.c gold_solver.c wavefront.c kernels.c redblack.c multigrid.c numa.c ooc.c checkpoint.c mproc.c lowprec.c profile.c stencil.c batch.c warm.c snapshot.c -O3 -Wall -std=c99 -lm -lpthread -lrt
  * OR
  * make build
  *
- * If you wish to see debug info, add the -D DEBUG option when compiling the code.
+ * If you wish to see debug info, add the -D DEBUG option when compiling the code. The
+ * reference and multi-thread grids then also go to the snapshot file (jacobi.snap unless
+ * --snapshot says otherwise).
  */
 
+#define _GNU_SOURCE     /* pthread_barrier_t and getopt are hidden by -std=c99 otherwise */
+
 #include <stdio.h>
 #include <string.h>
 #include <malloc.h>
@@ -18,46 +22,287 @@
 #include <pthread.h>
 #include <math.h>
 #include <sys/time.h>
+#include <unistd.h>
+#include <getopt.h>
 #include "grid.h" 
 
+/* Solvers that can be picked with the -s option */
+#define SOLVER_JACOBI 0     /* threads created and joined on every iteration */
+#define SOLVER_POOL 1       /* persistent threads synchronized by a barrier */
+#define SOLVER_WAVEFRONT 2  /* temporally blocked, several levels per pass (wavefront.c) */
+#define SOLVER_REDBLACK 3   /* in-place red-black Gauss-Seidel (redblack.c) */
+#define SOLVER_MULTIGRID 4  /* geometric multigrid cycles (multigrid.c) */
+#define SOLVER_OOC 5        /* jacobi on grids mapped from files, larger than RAM (ooc.c) */
+#define SOLVER_PROCS 6      /* jacobi split over processes exchanging halos in shared memory (mproc.c) */
+#define SOLVER_INPLACE 7    /* persistent threads sweeping a single grid in place with rolling row buffers */
+
+#define TIME_STEPS 4        /* Default levels per pass for SOLVER_WAVEFRONT */
+#define SNAPSHOT_EVERY 100  /* Default iterations between snapshots with --snapshot */
+
 /* function declaration */
 extern int compute_gold (grid_t *);
-grid_t * compute_using_pthreads_jacobi (grid_t *, int);
 void compute_grid_differences(grid_t *, grid_t *);
 grid_t *create_grid (int, float, float);
 grid_t *copy_grid (grid_t *);
-void print_grid (grid_t *);
 void print_stats (grid_t *, int);
 double grid_mse (grid_t *, grid_t *);
-void pthreads_solver(void*);
 void print_single_thread_file(void);
+void print_usage (char *);
+void solve_out_of_core (int, int, float, float, const char *);
 
-/* Structure that holds the arguments for thread function */
-typedef struct args_for_thread_s {
-    int tid;        /* Thread ID */
-    int num_iter;
-    int num_threads;
-} ARGS_FOR_THREAD_t;
-
-/* Global variables for all threads */
-grid_t *grid_multi_0;
-grid_t *grid_multi_1;
-double diff_multi;
-int num_elements_multi, num_iter_multi;
-pthread_mutex_t mutex1;
+/* Global variables */
+int time_steps = TIME_STEPS;        /* Levels per pass for SOLVER_WAVEFRONT */
 
 int 
 main (int argc, char **argv)
 {	
+    /* Parse options */
+    int solver = SOLVER_JACOBI;
+    char *kernel = "auto";
+    int mg_gamma = 1;           /* cycles per level for -s multigrid: 1 = V, 2 = W */
+    float omega = 1.0;          /* SOR factor, 0 picks it from dim, OMEGA_ADAPT from the convergence rate */
+    char *ooc_path = "jacobi_grid"; /* backing files for -s ooc are ooc_path.0 and ooc_path.1 */
+    char *checkpoint_path = "jacobi.ckpt";
+    char *resume_path = NULL;
+    int storage = STORAGE_FP32; /* -b: grid storage of the jacobi solvers */
+    int scaling_report = 0;     /* -S: time -s procs with 1, 2, 4, ... processes first */
+    char *trace_path = NULL;    /* -P: profile the jacobi threads, trace goes here */
+    char *stencil_name = "5pt";
+    char *batch_path = NULL;    /* --batch: solve the grids listed in this file instead */
+    int warm_steps = 0;         /* --warm-start: boundary steps solved warm and cold after the solve */
+    int reference = 1;          /* --no-reference: skip the single threaded solve and the grid it needs */
+    char *snapshot_path = NULL; /* --snapshot: write the grid to this file every snapshot_every iterations */
+    int snapshot_format = -1;   /* --snapshot-format, SNAPSHOT_F32 unless given */
+    static struct option long_options[] = {
+        {"resume", required_argument, NULL, 'R'},
+        {"stencil", required_argument, NULL, 'E'},
+        {"batch", required_argument, NULL, 'B'},
+        {"warm-start", required_argument, NULL, 'W'},
+        {"no-reference", no_argument, NULL, 'N'},
+        {"snapshot", required_argument, NULL, 'V'},
+        {"snapshot-every", required_argument, NULL, 'v'},
+        {"snapshot-format", required_argument, NULL, 'F'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long (argc, argv, "s:d:t:T:k:M:w:c:pfo:C:I:Sb:P:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 's':
+                if (strcmp (optarg, "jacobi") == 0)
+                    solver = SOLVER_JACOBI;
+                else if (strcmp (optarg, "pool") == 0)
+                    solver = SOLVER_POOL;
+                else if (strcmp (optarg, "wavefront") == 0)
+                    solver = SOLVER_WAVEFRONT;
+                else if (strcmp (optarg, "redblack") == 0)
+                    solver = SOLVER_REDBLACK;
+                else if (strcmp (optarg, "multigrid") == 0)
+                    solver = SOLVER_MULTIGRID;
+                else if (strcmp (optarg, "ooc") == 0)
+                    solver = SOLVER_OOC;
+                else if (strcmp (optarg, "procs") == 0)
+                    solver = SOLVER_PROCS;
+                else if (strcmp (optarg, "inplace") == 0)
+                    solver = SOLVER_INPLACE;
+                else {
+                    printf ("Unknown solver: %s\n", optarg);
+                    print_usage (argv[0]);
+                }
+                break;
+            case 'd':
+                if (strcmp (optarg, "cyclic") == 0)
+                    decomposition = DECOMP_CYCLIC;
+                else if (strcmp (optarg, "block") == 0)
+                    decomposition = DECOMP_BLOCK;
+                else {
+                    printf ("Unknown decomposition: %s\n", optarg);
+                    print_usage (argv[0]);
+                }
+                break;
+            case 't':
+                tile_width = atoi (optarg);
+                break;
+            case 'T':
+                time_steps = atoi (optarg);
+                break;
+            case 'k':
+                kernel = optarg;
+                break;
+            case 'M':
+                if (strcmp (optarg, "V") == 0)
+                    mg_gamma = 1;
+                else if (strcmp (optarg, "W") == 0)
+                    mg_gamma = 2;
+                else {
+                    printf ("Unknown multigrid cycle: %s\n", optarg);
+                    print_usage (argv[0]);
+                }
+                break;
+            case 'w':
+                if (strcmp (optarg, "auto") == 0)
+                    omega = 0.0;
+                else if (strcmp (optarg, "adapt") == 0)
+                    omega = OMEGA_ADAPT;
+                else if ((omega = atof (optarg)) <= 0.0 || omega >= 2.0) {
+                    printf ("omega must be between 0 and 2\n");
+                    print_usage (argv[0]);
+                }
+                break;
+            case 'c':
+                if (strcmp (optarg, "async") == 0)
+                    check_interval = CHECK_ASYNC;
+                else if ((check_interval = atoi (optarg)) < 1) {
+                    printf ("The convergence check interval must be at least 1\n");
+                    print_usage (argv[0]);
+                }
+                break;
+            case 'p':
+                pin_threads = 1;
+                break;
+            case 'f':
+                first_touch = 1;
+                break;
+            case 'o':
+                ooc_path = optarg;
+                break;
+            case 'C':
+                checkpoint_path = optarg;
+                break;
+            case 'I':
+                if ((checkpoint_every = atoi (optarg)) < 1) {
+                    printf ("The checkpoint interval must be at least 1\n");
+                    print_usage (argv[0]);
+                }
+                break;
+            case 'R':
+                resume_path = optarg;
+                break;
+            case 'S':
+                scaling_report = 1;
+                break;
+            case 'b':
+                if (strcmp (optarg, "fp32") == 0)
+                    storage = STORAGE_FP32;
+                else if (strcmp (optarg, "bf16") == 0)
+                    storage = STORAGE_BF16;
+                else if (strcmp (optarg, "fp16") == 0)
+                    storage = STORAGE_FP16;
+                else {
+                    printf ("Unknown storage: %s\n", optarg);
+                    print_usage (argv[0]);
+                }
+                break;
+            case 'P':
+                trace_path = optarg;
+                break;
+            case 'E':
+                stencil_name = optarg;
+                break;
+            case 'B':
+                batch_path = optarg;
+                break;
+            case 'N':
+                reference = 0;
+                break;
+            case 'V':
+                snapshot_path = optarg;
+                break;
+            case 'v':
+                if ((snapshot_every = atoi (optarg)) < 1) {
+                    printf ("The snapshot interval must be at least 1\n");
+                    print_usage (argv[0]);
+                }
+                break;
+            case 'F':
+                if (strcmp (optarg, "f32") == 0)
+                    snapshot_format = SNAPSHOT_F32;
+                else if (strcmp (optarg, "bf16") == 0)
+                    snapshot_format = SNAPSHOT_BF16;
+                else {
+                    printf ("Unknown snapshot format: %s\n", optarg);
+                    print_usage (argv[0]);
+                }
+                break;
+            case 'W':
+                if ((warm_steps = atoi (optarg)) < 1) {
+                    printf ("The number of warm start steps must be at least 1\n");
+                    print_usage (argv[0]);
+                }
+                break;
+            default:
+                print_usage (argv[0]);
+        }
+    }
+
     /* Check argument input */
-	if (argc < 5) {
-        printf ("Usage: %s grid-dimension num-threads min-temp max-temp\n", argv[0]);
-        printf ("OR: make run grid-dimension=[va1] num-threads=[val2] min-temp=[val3] max-temp=[val4]\n");
-        printf ("grid-dimension: The dimension of the grid\n");
-        printf ("num-threads: Number of threads\n"); 
-        printf ("min-temp, max-temp: Heat applied to the north side of the plate is uniformly distributed between min-temp and max-temp\n");
+	if (argc - optind < 4)
+        print_usage (argv[0]);
+
+    if (select_stencil_kernel (kernel) != 0) {
+        printf ("Stencil kernel %s is unknown or not supported by this CPU\n", kernel);
         exit (EXIT_FAILURE);
     }
+    if (select_stencil (stencil_name) != 0) {
+        printf ("Unknown stencil: %s\n", stencil_name);
+        print_usage (argv[0]);
+    }
+    if (strcmp (stencil->name, "5pt") != 0) {
+        /* the other engines, the checkpoints and first touch only know 2-D 5-point grids */
+        if ((solver != SOLVER_JACOBI && solver != SOLVER_POOL && (solver != SOLVER_INPLACE || stencil->ndim != 2))
+            || storage != STORAGE_FP32 || omega != 1.0 || first_touch || checkpoint_every > 0 || resume_path != NULL) {
+            printf ("--stencil %s only works with -s jacobi, pool or (2-D) inplace, without -b, -w, -f, -I and --resume\n",
+                    stencil->name);
+            exit (EXIT_FAILURE);
+        }
+        printf ("Using the %d-D %d-point stencil\n", stencil->ndim, stencil->points);
+    }
+    printf ("Using the %s stencil kernel\n", kernel_name);
+    if (storage != STORAGE_FP32) {
+        if (solver != SOLVER_JACOBI && solver != SOLVER_POOL) {
+            printf ("-b only applies to -s jacobi and -s pool\n");
+            exit (EXIT_FAILURE);
+        }
+        if (!storage_supported (storage)) {
+            printf ("%s storage is not supported by this CPU\n", storage_name (storage));
+            exit (EXIT_FAILURE);
+        }
+    }
+    if (omega != 1.0 && solver != SOLVER_REDBLACK) {
+        /* the jacobi engines, wavefront, multigrid and the processes have no relaxation factor */
+        printf ("-w only applies to -s redblack\n");
+        exit (EXIT_FAILURE);
+    }
+    if (warm_steps > 0 && ((solver != SOLVER_JACOBI && solver != SOLVER_POOL) || storage != STORAGE_FP32)) {
+        printf ("--warm-start only applies to -s jacobi and -s pool with fp32 storage\n");
+        exit (EXIT_FAILURE);
+    }
+    if (trace_path != NULL && ((solver != SOLVER_JACOBI && solver != SOLVER_POOL && solver != SOLVER_INPLACE)
+                               || storage != STORAGE_FP32)) {
+        printf ("-P only applies to -s jacobi, pool and inplace with fp32 storage\n");
+        exit (EXIT_FAILURE);
+    }
+    if ((checkpoint_every > 0 || resume_path != NULL)
+        && ((solver != SOLVER_JACOBI && solver != SOLVER_POOL && solver != SOLVER_INPLACE) || storage != STORAGE_FP32
+            || batch_path != NULL)) {
+        printf ("-I and --resume only apply to -s jacobi, pool and inplace with fp32 storage, without --batch\n");
+        exit (EXIT_FAILURE);
+    }
+    if (snapshot_path == NULL && (snapshot_every > 0 || snapshot_format >= 0)) {
+        printf ("--snapshot-every and --snapshot-format need --snapshot\n");
+        exit (EXIT_FAILURE);
+    }
+    if (snapshot_path != NULL && ((solver != SOLVER_JACOBI && solver != SOLVER_POOL && solver != SOLVER_INPLACE)
+                                  || storage != STORAGE_FP32)) {
+        printf ("--snapshot only applies to -s jacobi, pool and inplace with fp32 storage\n");
+        exit (EXIT_FAILURE);
+    }
+    if (solver == SOLVER_INPLACE && check_interval == CHECK_ASYNC && (snapshot_path != NULL || checkpoint_every > 0)) {
+        /* the pool never stops with -c async, so the single grid is never still enough to copy */
+        printf ("-s inplace -c async writes neither snapshots nor checkpoints, drop -c async or --snapshot and -I\n");
+        exit (EXIT_FAILURE);
+    }
+    if (snapshot_format < 0)
+        snapshot_format = SNAPSHOT_F32;
 
     /* Save results of the Single thread ouput to this file */
     FILE * output;
@@ -68,195 +313,225 @@ main (int argc, char **argv)
     double time_taken;
 
     /* Parse command-line arguments. */
-    int dim = atoi (argv[1]);
-    int num_threads = atoi (argv[2]);
-    float min_temp = atof (argv[3]);
-    float max_temp = atof (argv[4]);
+    int dim = atoi (argv[optind]);
+    int num_threads = atoi (argv[optind + 1]);
+    float min_temp = atof (argv[optind + 2]);
+    float max_temp = atof (argv[optind + 3]);
+    if (omega == 0.0)
+        omega = sor_omega (dim);
+
+    /* Many small grids: one grid per thread, no single threaded reference */
+    if (batch_path != NULL) {
+        fclose (output);
+        solve_batch (batch_path, num_threads);
+        exit (EXIT_SUCCESS);
+    }
+
+    /* Grids larger than RAM: no in-memory copies and no single threaded reference */
+    if (solver == SOLVER_OOC) {
+        fclose (output);
+        solve_out_of_core (dim, num_threads, min_temp, max_temp, ooc_path);
+        exit (EXIT_SUCCESS);
+    }
     
-    /* Generate the grids and populate them with initial conditions. */
- 	grid_t *grid_1 = create_grid (dim, min_temp, max_temp);
-    /* Grid 2 should have the same initial conditions as Grid 1. */
-    grid_t *grid_2 = copy_grid (grid_1);
-    /* copy grid 2 to global grids for multithread computation */
-    grid_multi_0 = copy_grid (grid_2); 
-    grid_multi_1 = copy_grid (grid_2); 
+    /* Generate the grids and populate them with initial conditions, or pick up a checkpoint. */
+ 	grid_t *grid_1;
+    if (resume_path != NULL) {
+        double resume_diff;
+        grid_t *checkpoint = checkpoint_map (resume_path, &start_iter_multi, &resume_diff);
+        if (checkpoint == NULL)
+            exit (EXIT_FAILURE);
+        if (checkpoint->dim != dim)
+            printf ("Using the checkpoint's grid dimension %d instead of %d\n", checkpoint->dim, dim);
+        dim = checkpoint->dim;
+        printf ("Resuming from %s after %d iterations, DIFF: %f\n", resume_path, start_iter_multi, resume_diff);
+        grid_1 = copy_grid (checkpoint);
+        checkpoint_unmap (checkpoint);
+    } else {
+        grid_1 = create_grid (dim, min_temp, max_temp);
+    }
+    /* Grid 2 should have the same initial conditions as Grid 1. The multi-thread solvers
+     * start from grid 2 and only the ones that swap two grids get a second one. */
+    int two_grids = (storage == STORAGE_FP32
+                     && (solver == SOLVER_JACOBI || solver == SOLVER_POOL || solver == SOLVER_WAVEFRONT));
+    grid_t *grid_2;
+    if (first_touch) {
+        /* let the threads that will sweep the rows place their pages */
+        int cyclic = (decomposition == DECOMP_CYCLIC && (solver == SOLVER_JACOBI || solver == SOLVER_POOL));
+        grid_2 = copy_grid_first_touch (grid_1, num_threads, cyclic);
+        grid_multi_1 = two_grids ? copy_grid_first_touch (grid_2, num_threads, cyclic) : NULL;
+    } else {
+        grid_2 = reference ? copy_grid (grid_1) : grid_1;
+        grid_multi_1 = two_grids ? copy_grid (grid_2) : NULL;
+    }
+    if (!reference && grid_1 != grid_2) {
+        free ((void *) grid_1->element);
+        free ((void *) grid_1);
+    }
+    if (!reference)
+        grid_1 = NULL;
+    grid_multi_0 = grid_2;
+    grid_t *grid_start = grid_2, *grid_spare = grid_multi_1;
+#ifdef DEBUG
+    if (snapshot_path == NULL)
+        snapshot_path = "jacobi.snap";
+#endif
+    if (snapshot_path != NULL) {
+        if (snapshot_every == 0)
+            snapshot_every = SNAPSHOT_EVERY;
+        snapshot_start (snapshot_path, dim, snapshot_format);
+    }
+    if (pin_threads || first_touch) {
+        print_thread_layout (grid_2, num_threads,
+                             decomposition == DECOMP_CYCLIC && (solver == SOLVER_JACOBI || solver == SOLVER_POOL));
+    }
 
 	/* Compute the reference solution using the single-threaded version. */
-	printf ("\nUsing the single threaded version to solve the grid\n");
-
-    gettimeofday (&start, NULL); /* Start timer */
-	int num_iter = compute_gold (grid_1);
-    gettimeofday (&stop, NULL); /* End timer */
-    time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
-
-    /* Print key statistics for single thread computation to ouput file. */
-	fprintf (output, "Solution computed using single thread in: %fs\n", time_taken);
-	fprintf (output,"Convergence achieved after %d iterations\n", num_iter);
-    fprintf (output, "Statistics for the interior grid points:\n");
-	printf ("Statistics for the interior grid points:\n");
-    fclose(output);
+    int num_iter = 0;
+    if (reference) {
+        printf ("\nUsing the single threaded version to solve the grid\n");
+
+        gettimeofday (&start, NULL); /* Start timer */
+        num_iter = compute_gold (grid_1);
+        gettimeofday (&stop, NULL); /* End timer */
+        time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
+
+        /* Print key statistics for single thread computation to ouput file. */
+        fprintf (output, "Solution computed using single thread in: %fs\n", time_taken);
+        fprintf (output,"Convergence achieved after %d iterations\n", num_iter);
+        fprintf (output, "Statistics for the interior grid points:\n");
+        printf ("Statistics for the interior grid points:\n");
+        fclose(output);
 
-    print_stats (grid_1, 1);
+        print_stats (grid_1, 1);
 #ifdef DEBUG
-    print_grid (grid_1);
+        snapshot_grid (grid_1, num_iter, 0.0);
 #endif
+    } else {
+        fclose (output);
+    }
+
+    /* Solve the same grid with single-threaded SOR and compare it with compute_gold. */
+    if (reference && omega != 1.0) {
+        grid_t *grid_sor = copy_grid (grid_2);
+        double gold_time = time_taken;
+
+        if (omega == OMEGA_ADAPT)
+            printf ("\nUsing single threaded SOR with adaptive omega to solve the grid\n");
+        else
+            printf ("\nUsing single threaded SOR with omega = %f to solve the grid\n", omega);
+        gettimeofday (&start, NULL); /* Start timer */
+        int num_iter_sor = compute_gold_sor (grid_sor, omega);
+        gettimeofday (&stop, NULL); /* End timer */
+        time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
+
+        output = fopen("single_thread_output", "a");
+        fprintf (output, "Solution computed using single thread SOR in: %fs\n", time_taken);
+        fprintf (output, "Convergence achieved after %d iterations\n", num_iter_sor);
+        fprintf (output, "SOR saved %d iterations and %fs relative to compute_gold\n",
+                 num_iter - num_iter_sor, gold_time - time_taken);
+        fprintf (output, "MSE between SOR and compute_gold: %f\n\n", grid_mse (grid_1, grid_sor));
+        fclose(output);
+
+        free ((void *) grid_sor->element);
+        free ((void *) grid_sor);
+    }
 	
-	/* Use pthreads to solve the equation using the jacobi method. */
-	printf ("\nUsing pthreads to solve the grid using the jacobi method\n");
+	/* Use pthreads to solve the equation using the jacobi method, or red-black Gauss-Seidel. */
+    if (solver == SOLVER_REDBLACK)
+        printf ("\nUsing pthreads to solve the grid using the red-black Gauss-Seidel method\n");
+    else if (solver == SOLVER_MULTIGRID)
+        printf ("\nUsing pthreads to solve the grid using %c-cycle multigrid\n", (mg_gamma == 1) ? 'V' : 'W');
+    else if (solver == SOLVER_PROCS)
+        printf ("\nUsing %d processes to solve the grid using the jacobi method\n", num_threads);
+    else if (solver == SOLVER_INPLACE)
+        printf ("\nUsing pthreads to solve the grid in place using the jacobi method\n");
+    else
+        printf ("\nUsing pthreads to solve the grid using the jacobi method\n");
+    if (solver == SOLVER_PROCS && scaling_report)
+        report_process_scaling (grid_2, num_threads);
+    if (checkpoint_every > 0)
+        checkpoint_start (checkpoint_path, dim, start_iter_multi);
+    if (trace_path != NULL)
+        profile_start (num_threads);
     gettimeofday (&start, NULL); /* Start timer */
-	grid_2 = compute_using_pthreads_jacobi (grid_2, num_threads);
+    if (storage != STORAGE_FP32)
+        grid_2 = compute_using_lowprec_jacobi (grid_2, num_threads, storage, &num_iter_multi);
+    else if (solver == SOLVER_POOL)
+        grid_2 = compute_using_pthreads_jacobi_pool (grid_2, num_threads);
+    else if (solver == SOLVER_WAVEFRONT)
+        grid_2 = compute_using_wavefront_jacobi (grid_multi_1, grid_multi_0, num_threads, time_steps,
+                                                 tile_width, &num_iter_multi);
+    else if (solver == SOLVER_REDBLACK)
+        grid_2 = compute_using_redblack_gs (grid_2, num_threads, omega, &num_iter_multi);
+    else if (solver == SOLVER_MULTIGRID)
+        grid_2 = compute_using_multigrid (grid_2, num_threads, mg_gamma, &num_iter_multi);
+    else if (solver == SOLVER_PROCS)
+        grid_2 = compute_using_processes (grid_2, num_threads, &num_iter_multi);
+    else if (solver == SOLVER_INPLACE)
+        grid_2 = compute_using_pthreads_jacobi_inplace (grid_2, num_threads);
+    else
+        grid_2 = compute_using_pthreads_jacobi (grid_2, num_threads);
     gettimeofday (&stop, NULL); /* End timer */
     time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
+    print_diff_log ();
+    if (checkpoint_every > 0)
+        checkpoint_stop ();
+    if (trace_path != NULL)
+        profile_stop (trace_path);
+
+    /* the spare grid of the solvers that swap two grids is whichever one they did not return */
+    if (grid_2 == grid_spare)
+        grid_spare = grid_start;
 
     /* print single thread ouputfile */
-    printf("\nResults from single thread computation:\n");
-    print_single_thread_file();
+    if (reference) {
+        printf("\nResults from single thread computation:\n");
+        print_single_thread_file();
+    }
     /* Print key statistics for multi-thread computation to stdout */
     printf("Results from multi-thread computation:\n");
 	printf ("Solution computed using %d thread in: %fs\n", num_threads, time_taken);
-    printf ("Convergence achieved after %d iterations\n", num_iter_multi);			
+    if (solver == SOLVER_MULTIGRID) {
+        /* a cycle sweeps every level several times, so cycles say nothing about fine grid updates */
+        printf ("Convergence achieved after %d cycles\n", num_iter_multi);
+    } else {
+        printf ("Convergence achieved after %d iterations\n", num_iter_multi);			
+        printf ("Effective lattice updates per second: %e\n", (double) stencil_lines (dim) * (dim - 2) * (num_iter_multi - start_iter_multi)/time_taken);
+    }
     printf ("Statistics for the interior grid points:\n");
 	print_stats (grid_2, 0);
 
 #ifdef DEBUG
-    print_grid (grid_2. 0);
+    snapshot_grid (grid_2, num_iter_multi, 0.0);
 #endif
-    
+    snapshot_stop ();
+
     /* Compute grid differences. */
-    double mse = grid_mse (grid_1, grid_2);
-    printf ("MSE between the two grids: %f\n", mse);
+    if (reference) {
+        double mse = grid_mse (grid_1, grid_2);
+        printf ("MSE between the two grids: %f\n", mse);
+    }
+    if (storage != STORAGE_FP32) {
+        printf ("(multi-thread grid stored as %s until its precision floor, fp32 after)\n", storage_name (storage));
+    }
+    if (warm_steps > 0) {
+        report_warm_start (grid_2, num_threads, min_temp, max_temp, warm_steps);
+    }
 
 	/* Free up the grid data structures. */
-	free ((void *) grid_1->element);	
-	free ((void *) grid_1); 
+    if (grid_1 != NULL) {
+        free ((void *) grid_1->element);	
+        free ((void *) grid_1); 
+    }
 	free ((void *) grid_2->element);	
 	free ((void *) grid_2);
-
-	exit (EXIT_SUCCESS);
-}
-
-/*------------------------------------------------------------------
- * Function:    compute_using_pthreads_jacobi
- * Purpose:     Create threads and split the work evenly among them,
- *              set input in args_for_thread stuct and call pthread solver
- *              repead until convergence is at required amount
- *              
- * Input args:  *grid, num_threads
- * Return val:  grid_t* 
- */  /*  */
-grid_t * 
-compute_using_pthreads_jacobi (grid_t *grid, int num_threads)
-{
-    /* verify input arguments */
-    if (num_threads < 2){
-        printf("You only chose one thread, Multi-Thread can't be done!\n");
-        return 0;
-    }
-    int num_iter = 0;
-	int done = 0;
-    float eps = 1e-6;
-    pthread_t *worker_thread = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
-    diff_multi = 0;
-    num_elements_multi =0;
-
-    /* repeat until convergence is achieved */
-    while(!done){
-
-        /* load arguments into thread */
-        for (int i=0; i< num_threads; i++){
-            ARGS_FOR_THREAD_t *args_for_thread = malloc(sizeof(ARGS_FOR_THREAD_t));
-            args_for_thread->tid = i;
-            args_for_thread->num_iter = num_iter;
-            args_for_thread->num_threads = num_threads;
-
-            /* create thread */
-            if ((pthread_create (&worker_thread[i], NULL, (void*)pthreads_solver, (void *)args_for_thread)) != 0) {
-                perror ("pthread_create");
-                exit (EXIT_FAILURE);
-            }
-        }
-        /* wait for all threads to finish */
-        for (int i = 0; i < num_threads; i++){
-            pthread_join (worker_thread[i], NULL);
-        }
-        
-        /* reset global variables, test for convergence */
-        double test = diff_multi/num_elements_multi;
-        num_iter++;
-        diff_multi = 0.0;
-        num_elements_multi = 0;
-        if (test < eps) 
-            done = 1;
-
-        printf ("Iteration: %d - DIFF: %f\n", num_iter, test);
-    }
-    /* return newest grid value when convergence is achieved */
-    num_iter_multi = num_iter;
-    if (num_iter %2 == 1){
-        return grid_multi_0;
-    } else {
-        return grid_multi_1;
+    if (grid_spare != NULL) {
+        free ((void *) grid_spare->element);
+        free ((void *) grid_spare);
     }
-}
-
-/*------------------------------------------------------------------
- * Function:    pthreads_solver
- * Purpose:     Calculate the value for every element in the grid in a multi-thread fashion 
- *              each thread processes a different row, they read from one grid and write to another
- *              switch between grids so the newest one is always being read from
- *              
- * Input args:  this_arg (thread argument structure)
- * Return val:  none 
- */  /*  */
-void
-pthreads_solver(void* this_arg)
-{
-    ARGS_FOR_THREAD_t *args_for_me = (ARGS_FOR_THREAD_t *) this_arg;
-
-    int i, j;
-	double diff = 0.0;
-	float old, new; 
-    int num_elements = 0; 
-    int num_iter = args_for_me->num_iter;
-
-    if (num_iter %2 == 1){
-        for (i = 1 + args_for_me->tid; i < (grid_multi_0->dim - 1); i += args_for_me->num_threads) { /* each thread processes a different row */
-            for (j = 1; j < (grid_multi_0->dim - 1); j++) {
-                old = grid_multi_0->element[i * grid_multi_0->dim + j]; /* Store old value of grid point from read grid. */
-                /* Apply the update rule. */	
-                new = 0.25 * (grid_multi_0->element[(i - 1) * grid_multi_0->dim + j] +\
-                                grid_multi_0->element[(i + 1) * grid_multi_0->dim + j] +\
-                                grid_multi_0->element[i * grid_multi_0->dim + (j + 1)] +\
-                                grid_multi_0->element[i * grid_multi_0->dim + (j - 1)]);
-
-                grid_multi_1->element[i * grid_multi_1->dim + j] = new; /* Update the grid-point value on write grid. */
-                diff = diff + fabs(new - old); /* Calculate the difference in values. */
-                num_elements++;
-            }
-        }
-    } else { /* switch read and write grids */
-        for (i = 1 + args_for_me->tid; i < (grid_multi_1->dim - 1); i += args_for_me->num_threads) {
-            for (j = 1; j < (grid_multi_1->dim - 1); j++) {
-                old = grid_multi_1->element[i * grid_multi_1->dim + j]; /* Store old value of grid point from read grid. */
-                /* Apply the update rule. */	
-                new = 0.25 * (grid_multi_1->element[(i - 1) * grid_multi_1->dim + j] +\
-                                grid_multi_1->element[(i + 1) * grid_multi_1->dim + j] +\
-                                grid_multi_1->element[i * grid_multi_1->dim + (j + 1)] +\
-                                grid_multi_1->element[i * grid_multi_1->dim + (j - 1)]);
-
-                grid_multi_0->element[i * grid_multi_0->dim + j] = new; /* Update the grid-point value from write grid. */
-                diff = diff + fabs(new - old); /* Calculate the difference in values. */
-                num_elements++;
-            }
-        }  
-    }
-    /* add the values of a threads together */
-    pthread_mutex_lock(&mutex1);
-    diff_multi += diff;
-    num_elements_multi += num_elements;
-    pthread_mutex_unlock(&mutex1);
-    return;
 
+	exit (EXIT_SUCCESS);
 }
 
 
@@ -269,23 +544,29 @@ create_grid (int dim, float min, float max)
         return NULL;
 
     grid->dim = dim;
-	grid->element = (float *) malloc (sizeof (float) * grid->dim * grid->dim);
+    long num_elem = stencil_points (dim);     /* dim^ndim of the stencil in use */
+	grid->element = (float *) malloc (sizeof (float) * num_elem);
     if (grid->element == NULL)
         return NULL;
 
-    int i, j;
-	for (i = 0; i < grid->dim; i++) {
-		for (j = 0; j < grid->dim; j++) {
-            grid->element[i * grid->dim + j] = 0.0; 			
-		}
+    long i;
+    int j, k;
+	for (i = 0; i < num_elem; i++) {
+        grid->element[i] = 0.0; 			
     }
 
-    /* Initialize the north side, that is row 0, with temperature values. */ 
+    /* Initialize the north side, that is row 0, with temperature values. In 3-D the
+     * north face is row 0 of every interior plane. */ 
     srand ((unsigned) time (NULL));
 	float val;		
-    for (j = 1; j < (grid->dim - 1); j++) {
-        val =  min + (max - min) * rand ()/(float)RAND_MAX;
-        grid->element[j] = val; 	
+    int k_first = (stencil->ndim == 2) ? 0 : 1;
+    int k_last = (stencil->ndim == 2) ? 0 : grid->dim - 2;
+    for (k = k_first; k <= k_last; k++) {
+        float *north = &grid->element[(long) k * grid->dim * grid->dim];
+        for (j = 1; j < (grid->dim - 1); j++) {
+            val =  min + (max - min) * rand ()/(float)RAND_MAX;
+            north[j] = val; 	
+        }
     }
 
     return grid;
@@ -300,34 +581,19 @@ copy_grid (grid_t *grid)
         return NULL;
 
     new_grid->dim = grid->dim;
-	new_grid->element = (float *) malloc (sizeof (float) * new_grid->dim * new_grid->dim);
+    long num_elem = stencil_points (grid->dim);
+	new_grid->element = (float *) malloc (sizeof (float) * num_elem);
     if (new_grid->element == NULL)
         return NULL;
 
-    int i, j;
-	for (i = 0; i < new_grid->dim; i++) {
-		for (j = 0; j < new_grid->dim; j++) {
-            new_grid->element[i * new_grid->dim + j] = grid->element[i * new_grid->dim + j] ; 			
-		}
+    long i;
+	for (i = 0; i < num_elem; i++) {
+        new_grid->element[i] = grid->element[i]; 			
     }
 
     return new_grid;
 }
 
-/* This function prints the grid on the screen. */
-void 
-print_grid (grid_t *grid)
-{
-    int i, j;
-    for (i = 0; i < grid->dim; i++) {
-        for (j = 0; j < grid->dim; j++) {
-            printf ("%f\t", grid->element[i * grid->dim + j]);
-        }
-        printf ("\n");
-    }
-    printf ("\n");
-}
-
 
 /* Print out statistics for the converged values of the interior grid points, including min, max, and average. */
 void 
@@ -336,18 +602,20 @@ print_stats (grid_t *grid, int output_file)
     float min = INFINITY;
     float max = 0.0;
     double sum = 0.0;
-    int num_elem = 0;
-    int i, j;
+    long num_elem = 0;
+    long n, num_lines = stencil_lines (grid->dim);
+    int j;
 
-    for (i = 1; i < (grid->dim - 1); i++) {
+    for (n = 0; n < num_lines; n++) {
+        float *row = &grid->element[(long) stencil_line (n, grid->dim) * grid->dim];     /* i * dim overflows an int on out-of-core grids */
         for (j = 1; j < (grid->dim - 1); j++) {
-            sum += grid->element[i * grid->dim + j];
+            sum += row[j];
 
-            if (grid->element[i * grid->dim + j] > max) 
-                max = grid->element[i * grid->dim + j];
+            if (row[j] > max) 
+                max = row[j];
 
-             if(grid->element[i * grid->dim + j] < min) 
-                min = grid->element[i * grid->dim + j];
+             if(row[j] < min) 
+                min = row[j];
              
              num_elem++;
         }
@@ -376,8 +644,8 @@ double
 grid_mse (grid_t *grid_1, grid_t *grid_2)
 {
     double mse = 0.0;
-    int num_elem = grid_1->dim * grid_1->dim;
-    int i;
+    long num_elem = stencil_points (grid_1->dim);
+    long i;
 
     for (i = 0; i < num_elem; i++) 
         mse += (grid_1->element[i] - grid_2->element[i]) * (grid_1->element[i] - grid_2->element[i]);
@@ -385,6 +653,108 @@ grid_mse (grid_t *grid_1, grid_t *grid_2)
     return mse/num_elem; 
 }
 
+/*------------------------------------------------------------------
+ * Function:    solve_out_of_core
+ * Purpose:     Run -s ooc: create the grids in the files path.0 and path.1,
+ *              solve them with compute_using_ooc_jacobi and report the same
+ *              numbers as the in-memory solvers. The files are left behind
+ *              holding the solution
+ *
+ * Input args:  dim, num_threads, min_temp, max_temp, path
+ * Return val:  none
+ */  /*  */
+void
+solve_out_of_core (int dim, int num_threads, float min_temp, float max_temp, const char *path)
+{
+    char path_0[FILENAME_MAX], path_1[FILENAME_MAX];
+    struct timeval start, stop;
+    int num_iter;
+    int j;
+
+    snprintf (path_0, sizeof (path_0), "%s.0", path);
+    snprintf (path_1, sizeof (path_1), "%s.1", path);
+    grid_t *grid_0 = map_grid (path_0, dim);
+    grid_t *grid_1 = map_grid (path_1, dim);
+    if (grid_0 == NULL || grid_1 == NULL)
+        exit (EXIT_FAILURE);
+
+    /* Same initial conditions as create_grid, the rest of a new file is already zero */
+    srand ((unsigned) time (NULL));
+    for (j = 1; j < (dim - 1); j++) {
+        grid_0->element[j] = min_temp + (max_temp - min_temp) * rand ()/(float)RAND_MAX;
+        grid_1->element[j] = grid_0->element[j];
+    }
+
+    printf ("\nUsing pthreads to solve the grid out of core in %s and %s\n", path_0, path_1);
+    gettimeofday (&start, NULL); /* Start timer */
+    grid_t *solved = compute_using_ooc_jacobi (grid_0, grid_1, num_threads, 0, &num_iter);
+    gettimeofday (&stop, NULL); /* End timer */
+    double time_taken = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000); /* Compute time taken */
+
+    printf ("Solution computed using %d thread in: %fs\n", num_threads, time_taken);
+    printf ("Convergence achieved after %d iterations\n", num_iter);
+    printf ("Effective lattice updates per second: %e\n", (double) (dim - 2) * (dim - 2) * num_iter/time_taken);
+    printf ("Statistics for the interior grid points:\n");
+    print_stats (solved, 0);
+    printf ("Solution left in %s\n", (solved == grid_0) ? path_0 : path_1);
+
+    unmap_grid (grid_0);
+    unmap_grid (grid_1);
+}
+
+/* Print how to run the program and exit. */
+void
+print_usage (char *name)
+{
+    printf ("Usage: %s [-s solver] [-d decomposition] [-t tile-width] [-T time-steps] [-k kernel] [-M cycle] [-w omega] [-c interval] [-p] [-f] [-o path] [-C path] [-I interval] [--resume path] [-S] [-b storage] [-P path] [--stencil name] [--batch path] [--warm-start steps] [--no-reference] [--snapshot path] [--snapshot-every interval] [--snapshot-format format] grid-dimension num-threads min-temp max-temp\n", name);
+    printf ("OR: make run grid-dimension=[va1] num-threads=[val2] min-temp=[val3] max-temp=[val4]\n");
+    printf ("grid-dimension: The dimension of the grid\n");
+    printf ("num-threads: Number of threads\n"); 
+    printf ("min-temp, max-temp: Heat applied to the north side of the plate is uniformly distributed between min-temp and max-temp\n");
+    printf ("-s solver: jacobi (threads created every iteration, default), pool (persistent threads and a barrier)\n");
+    printf ("           wavefront (temporally blocked, several iterations per pass over memory)\n");
+    printf ("           redblack (in-place red-black Gauss-Seidel), multigrid (V- or W-cycles)\n");
+    printf ("           ooc (jacobi on file-backed grids streamed in bands, for grids larger than RAM)\n");
+    printf ("           procs (jacobi in num-threads processes exchanging halo rows through shared memory)\n");
+    printf ("           or inplace (pool sweeping a single grid in place with rolling row buffers, always in row bands)\n");
+    printf ("-d decomposition: cyclic (row i goes to thread i %% num-threads, default) or block (contiguous row bands)\n");
+    printf ("-t tile-width: columns per cache tile with -d block or -s wavefront (default %d, 0 disables tiling)\n", TILE_WIDTH);
+    printf ("-T time-steps: iterations per pass with -s wavefront (default %d)\n", TIME_STEPS);
+    printf ("-k kernel: stencil kernel, auto (widest supported, default), scalar, sse, avx2, avx512\n");
+    printf ("           or generated (the 5-point kernel of the stencil engine)\n");
+    printf ("-M cycle: V (default) or W cycles with -s multigrid\n");
+    printf ("-w omega: with -s redblack over-relax it by omega and also run the single threaded reference as SOR,\n");
+    printf ("          auto (optimal value for the grid dimension) or adapt (estimated from the convergence rate)\n");
+    printf ("-c interval: with -s jacobi or pool test convergence every interval iterations (default 1),\n");
+    printf ("             or async to test it one iteration behind without stopping the pool (not with\n");
+    printf ("             -s inplace and --snapshot or -I)\n");
+    printf ("-p: pin solver thread i to one CPU, threads spread evenly over the NUMA nodes\n");
+    printf ("-f: have the solver threads first-touch the rows they own, so the pages land on their node\n");
+    printf ("-o path: with -s ooc keep the grids in path.0 and path.1 (default jacobi_grid)\n");
+    printf ("-I interval: with -s jacobi, pool or inplace write a checkpoint every interval iterations, in the\n");
+    printf ("             background\n");
+    printf ("-C path: file the checkpoints go to (default jacobi.ckpt)\n");
+    printf ("-b storage: with -s jacobi or pool store the grids as fp32 (default), bf16 or fp16, switching to\n");
+    printf ("            fp32 once the diff reaches the precision floor of the 16-bit format\n");
+    printf ("-S: with -s procs first print how the solve scales with 1, 2, 4, ... num-threads processes\n");
+    printf ("-P path: with -s jacobi or pool print per-thread compute and wait time and hardware counters\n");
+    printf ("         after the solve, and write a per-iteration trace of every thread to path\n");
+    printf ("--stencil name: update rule of the grid: 5pt (default), 9pt, or 7pt-3d for a dim^3 grid heated on its\n");
+    printf ("                north face; anything but 5pt only with -s jacobi or pool\n");
+    printf ("--batch path: solve every grid listed in path, one \"dim min-temp max-temp\" per line, each by one\n");
+    printf ("              of num-threads threads; grid-dimension, min-temp and max-temp are not used\n");
+    printf ("--warm-start steps: after the solve heat the north side in steps, solve each step from the previous\n");
+    printf ("                    solution and from scratch with the pool, and print the iterations saved\n");
+    printf ("--no-reference: skip the single threaded reference solve, so only the grids of the solver are allocated\n");
+    printf ("--snapshot path: with -s jacobi, pool or inplace write the grid to path every %d iterations, in the\n", SNAPSHOT_EVERY);
+    printf ("                 background, skipping a snapshot if the writer is still busy with the last ones\n");
+    printf ("--snapshot-every interval: iterations between snapshots\n");
+    printf ("--snapshot-format format: f32 (default) or bf16, half the size and plenty for plotting\n");
+    printf ("--resume path: with -s jacobi, pool or inplace start from a checkpoint, the grid dimension and\n");
+    printf ("               temperatures come from the file\n");
+    exit (EXIT_FAILURE);
+}
+
 /* print the contents of single_thread ouput file */
 void
 print_single_thread_file(void)
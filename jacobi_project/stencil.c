@@ -0,0 +1,205 @@
+/* Stencil engine: Jacobi and Gauss-Seidel line kernels generated per stencil.
+ *
+ * A stencil is a list of neighbour offsets (plane, row, column) in two
+ * groups, the face neighbours and the corner neighbours, each with one
+ * weight:
+ *
+ *     new = w_face * (sum of faces) + w_corner * (sum of corners)
+ *
+ * DEFINE_STENCIL expands one stencil into two kernels in which the offsets
+ * and weights are constants, so the neighbour sum is fully unrolled:
+ *
+ *  - stencil_line_NAME has the signature of jacobi_row and sweeps part of
+ *    one line (a row of a 2-D grid, a row of one plane of a 3-D grid) from
+ *    src to dst. The points are taken STENCIL_LANES at a time with one
+ *    accumulator per lane so the compiler can vectorize the loop, and it is
+ *    built for AVX-512, AVX2 and baseline x86-64 with the best picked at load
+ *    time.
+ *  - stencil_gold_NAME sweeps a whole line in place, in order, for the
+ *    single threaded Gauss-Seidel reference compute_gold.
+ *
+ * A grid of an N-D stencil holds dim^N floats, the last index running
+ * fastest. stencil_lines and stencil_line enumerate the interior lines so
+ * the threaded jacobi drivers can hand them out like the rows of a 2-D grid.
+ * The north boundary is the face with row index 0.
+ *
+ * The 5-point stencil sums its neighbours in the same order and with the
+ * same weight as kernels.c, so its generated kernel gives the same grids as
+ * the hand written ones.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "grid.h"
+
+#define STENCIL_LANES 16    /* Points per step of the generated jacobi kernels */
+
+#if defined(__x86_64__)
+#define STENCIL_CLONES __attribute__ ((target_clones ("avx512f", "avx2", "default")))
+#else
+#define STENCIL_CLONES
+#endif
+
+/* Neighbour lists, (plane, row, column) offsets in the order they are summed */
+#define FIVE_POINT_FACES(P) P (0, -1, 0) P (0, 1, 0) P (0, 0, 1) P (0, 0, -1)
+#define NINE_POINT_CORNERS(P) P (0, -1, -1) P (0, -1, 1) P (0, 1, -1) P (0, 1, 1)
+#define SEVEN_POINT_FACES(P) P (0, -1, 0) P (0, 1, 0) P (0, 0, 1) P (0, 0, -1) P (-1, 0, 0) P (1, 0, 0)
+#define NO_POINTS(P)
+
+/* One neighbour of the point c points at */
+#define STENCIL_POINT(dk, di, dj) + c[(dk) * plane + (di) * (long) dim + (dj)]
+
+/* The update rule of a stencil at the point c points at */
+#define STENCIL_RULE(FACES, W_FACE, CORNERS, W_CORNER) \
+    ((W_FACE) * (0.0f FACES (STENCIL_POINT)) + (W_CORNER) * (0.0f CORNERS (STENCIL_POINT)))
+
+#define DEFINE_STENCIL(NAME, FACES, W_FACE, CORNERS, W_CORNER)                                  \
+STENCIL_CLONES double                                                                           \
+stencil_line_##NAME (const float *restrict src, float *restrict dst, int dim, int i,            \
+                     int j_start, int j_end)                                                    \
+{                                                                                               \
+    const long plane = (long) dim * dim;                                                        \
+    const float *row = src + (long) i * dim;                                                    \
+    float *out = dst + (long) i * dim;                                                          \
+    double acc[STENCIL_LANES] = {0.0};                                                          \
+    double diff = 0.0;                                                                          \
+    int j = j_start, l;                                                                         \
+                                                                                                \
+    for (; j + STENCIL_LANES <= j_end; j += STENCIL_LANES) {                                    \
+        for (l = 0; l < STENCIL_LANES; l++) {                                                   \
+            const float *c = row + j + l;                                                       \
+            float new = STENCIL_RULE (FACES, W_FACE, CORNERS, W_CORNER);                        \
+            out[j + l] = new;                                                                   \
+            acc[l] += fabsf (new - c[0]);                                                       \
+        }                                                                                       \
+    }                                                                                           \
+    for (; j < j_end; j++) {                                                                    \
+        const float *c = row + j;                                                               \
+        float new = STENCIL_RULE (FACES, W_FACE, CORNERS, W_CORNER);                            \
+        out[j] = new;                                                                           \
+        diff += fabsf (new - c[0]);                                                             \
+    }                                                                                           \
+    for (l = 0; l < STENCIL_LANES; l++)                                                         \
+        diff += acc[l];                                                                         \
+    return diff;                                                                                \
+}                                                                                               \
+                                                                                                \
+double                                                                                          \
+stencil_gold_##NAME (float *grid, int dim, int i, double diff)                                  \
+{                                                                                               \
+    const long plane = (long) dim * dim;                                                        \
+    float *row = grid + (long) i * dim;                                                         \
+    int j;                                                                                      \
+                                                                                                \
+    for (j = 1; j < dim - 1; j++) {                                                             \
+        float *c = row + j;                                                                     \
+        float old = c[0];                                                                       \
+        float new = STENCIL_RULE (FACES, W_FACE, CORNERS, W_CORNER);                            \
+        c[0] = new;                                                                             \
+        diff = diff + fabs (new - old);                                                         \
+    }                                                                                           \
+    return diff;                                                                                \
+}
+
+DEFINE_STENCIL (5pt, FIVE_POINT_FACES, 0.25f, NO_POINTS, 0.0f)
+DEFINE_STENCIL (9pt, FIVE_POINT_FACES, 0.2f, NINE_POINT_CORNERS, 0.05f)
+DEFINE_STENCIL (7pt_3d, SEVEN_POINT_FACES, 1.0f/6.0f, NO_POINTS, 0.0f)
+
+/* Stencils that can be picked with --stencil, the first is the default */
+static const STENCIL_t stencils[] = {
+    {"5pt", 2, 5, stencil_line_5pt, stencil_gold_5pt},
+    {"9pt", 2, 9, stencil_line_9pt, stencil_gold_9pt},      /* 4 * faces + corners, over 20 */
+    {"7pt-3d", 3, 7, stencil_line_7pt_3d, stencil_gold_7pt_3d},
+};
+
+const STENCIL_t *stencil = &stencils[0];
+
+/*------------------------------------------------------------------
+ * Function:    select_stencil
+ * Purpose:     Make the stencil called name the one all grids and solvers
+ *              use. Any stencil but the default also points jacobi_row at
+ *              its generated kernel
+ *
+ * Input args:  name
+ * Return val:  0 on success, -1 if there is no such stencil
+ */  /*  */
+int
+select_stencil (const char *name)
+{
+    for (int k = 0; k < (int) (sizeof (stencils) / sizeof (stencils[0])); k++) {
+        if (strcmp (name, stencils[k].name) == 0) {
+            stencil = &stencils[k];
+            if (k > 0) {
+                jacobi_row = stencil->line;
+                kernel_name = "generated";
+            }
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*------------------------------------------------------------------
+ * Function:    select_stencil_kernel
+ * Purpose:     Point jacobi_row at the kernel called name: generated for
+ *              the generated kernel of the current stencil, any other name
+ *              as select_kernel takes it
+ *
+ * Input args:  name
+ * Return val:  0 on success, -1 if the kernel is unknown or not supported
+ */  /*  */
+int
+select_stencil_kernel (const char *name)
+{
+    if (strcmp (name, "generated") == 0) {
+        jacobi_row = stencil->line;
+        kernel_name = "generated";
+        return 0;
+    }
+    return select_kernel (name);
+}
+
+/* Number of floats in a grid of side dim. */
+long
+stencil_points (int dim)
+{
+    long n = 1;
+    for (int d = 0; d < stencil->ndim; d++)
+        n *= dim;
+    return n;
+}
+
+/* Number of interior lines in a grid of side dim, each with dim - 2 interior points. */
+long
+stencil_lines (int dim)
+{
+    long n = 1;
+    for (int d = 1; d < stencil->ndim; d++)
+        n *= dim - 2;
+    return n;
+}
+
+/*------------------------------------------------------------------
+ * Function:    stencil_line
+ * Purpose:     Map the n-th interior line to its line index, which is what
+ *              jacobi_row takes as i: the line starts at element i * dim
+ *
+ * Input args:  n, dim
+ * Return val:  line index
+ */  /*  */
+int
+stencil_line (long n, int dim)
+{
+    long line = 0, scale = 1;
+
+    /* the row index runs fastest, so consecutive lines are neighbours in memory */
+    for (int d = 1; d < stencil->ndim; d++) {
+        line += (1 + n % (dim - 2)) * scale;
+        n /= dim - 2;
+        scale *= dim;
+    }
+    return (int) line;
+}
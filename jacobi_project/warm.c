@@ -0,0 +1,148 @@
+/* Warm starts: solve a grid again after its north side changed.
+ *
+ * When the boundary temperatures are swept, the solution for one boundary
+ * is a far better first guess for the next than the zero interior
+ * create_grid starts from: the error left to remove is only the change of
+ * the boundary, smoothed into the plate. compute_warm_start puts the new
+ * north temperatures into an already solved grid and runs the jacobi pool
+ * from there, to the same eps as a cold solve.
+ *
+ * report_warm_start sweeps the north side of a solved grid in steps and
+ * solves every step both ways, to show what the warm start saves.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "grid.h"
+
+#define WARM_SHIFT 0.05     /* Each step of report_warm_start heats the north side by this fraction of max - min */
+
+/* Copy dim north temperatures into row 0 of grid, of every interior plane in 3-D. */
+static void
+set_north (grid_t *grid, const float *north)
+{
+    int dim = grid->dim;
+    int k_last = (stencil->ndim == 2) ? 0 : dim - 2;
+
+    for (int k = (stencil->ndim == 2) ? 0 : 1; k <= k_last; k++)
+        memcpy (&grid->element[(long) k * dim * dim + 1], north + 1, sizeof (float) * (dim - 2));
+}
+
+/*------------------------------------------------------------------
+ * Function:    compute_warm_start
+ * Purpose:     Give grid, usually the solution for an earlier boundary, the
+ *              north temperatures north[1 .. dim-2] and solve it in place
+ *              with the jacobi pool, starting from its current interior
+ *
+ * Input args:  grid, north, num_threads (at least 2)
+ * Output args: num_iter
+ * Return val:  grid, NULL if the pool could not run
+ */  /*  */
+grid_t *
+compute_warm_start (grid_t *grid, const float *north, int num_threads, int *num_iter)
+{
+    size_t size = sizeof (float) * stencil_points (grid->dim);
+    grid_t other;
+    int saved_checkpoint_every = checkpoint_every;
+    int saved_start_iter = start_iter_multi;
+
+    set_north (grid, north);
+    other.dim = grid->dim;
+    other.element = (float *) malloc (size);
+    if (other.element == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    memcpy (other.element, grid->element, size);
+
+    /* a fresh solve: count from zero and leave the checkpoints of the main solve alone */
+    checkpoint_every = 0;
+    start_iter_multi = 0;
+    grid_multi_0 = grid;
+    grid_multi_1 = &other;
+    grid_t *solved = compute_using_pthreads_jacobi_pool (grid, num_threads);
+    clear_diff_log ();
+    checkpoint_every = saved_checkpoint_every;
+    start_iter_multi = saved_start_iter;
+
+    if (solved == &other)
+        memcpy (grid->element, other.element, size);
+    free ((void *) other.element);
+    if (solved == NULL)
+        return NULL;
+    *num_iter = num_iter_multi;
+    return grid;
+}
+
+/*------------------------------------------------------------------
+ * Function:    report_warm_start
+ * Purpose:     Heat the north side of the solved grid by WARM_SHIFT * (max
+ *              - min) num_steps times. Solve each step warm, from the
+ *              previous step's solution, and cold, from a zero interior, and
+ *              print the iterations and time the warm start saves
+ *
+ * Input args:  grid (solved, left holding the last warm solution),
+ *              num_threads, min, max, num_steps
+ * Return val:  none
+ */  /*  */
+void
+report_warm_start (grid_t *grid, int num_threads, float min, float max, int num_steps)
+{
+    int dim = grid->dim;
+    size_t size = sizeof (float) * stencil_points (dim);
+    float *north = (float *) malloc (sizeof (float) * dim);
+    grid_t cold;
+    struct timeval start, stop;
+    int total_warm = 0, total_cold = 0;
+    int step, j;
+
+    cold.dim = dim;
+    cold.element = (float *) malloc (size);
+    if (north == NULL || cold.element == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+    /* the north row of the grid, of its first interior plane in 3-D */
+    memcpy (north, &grid->element[(stencil->ndim == 2) ? 0 : (long) dim * dim], sizeof (float) * dim);
+
+    printf ("\nWarm starts: the north side is heated by %.0f%% of max - min per step\n", 100.0 * WARM_SHIFT);
+    printf ("%5s %11s %13s %11s %13s %7s %9s %12s\n", "step", "warm iter", "warm time (s)", "cold iter",
+            "cold time (s)", "saved", "speedup", "MSE");
+    for (step = 1; step <= num_steps; step++) {
+        int warm_iter, cold_iter;
+
+        for (j = 1; j < dim - 1; j++)
+            north[j] += WARM_SHIFT * (max - min);
+
+        gettimeofday (&start, NULL);
+        if (compute_warm_start (grid, north, num_threads, &warm_iter) == NULL)
+            break;
+        gettimeofday (&stop, NULL);
+        double warm_time = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000);
+
+        /* a cold start is a warm start from a zero interior */
+        memset (cold.element, 0, size);
+        gettimeofday (&start, NULL);
+        compute_warm_start (&cold, north, num_threads, &cold_iter);
+        gettimeofday (&stop, NULL);
+        double cold_time = (double)(stop.tv_sec - start.tv_sec + (stop.tv_usec - start.tv_usec)/(double)1000000);
+
+        double mse = 0.0;
+        for (long i = 0; i < (long) (size / sizeof (float)); i++)
+            mse += (grid->element[i] - cold.element[i]) * (grid->element[i] - cold.element[i]);
+        mse /= size / sizeof (float);
+
+        printf ("%5d %11d %13f %11d %13f %6.1f%% %8.2fx %12e\n", step, warm_iter, warm_time, cold_iter, cold_time,
+                100.0 * (cold_iter - warm_iter)/cold_iter, cold_time/warm_time, mse);
+        total_warm += warm_iter;
+        total_cold += cold_iter;
+    }
+    printf ("Warm starts saved %d of %d iterations\n", total_cold - total_warm, total_cold);
+
+    free ((void *) north);
+    free ((void *) cold.element);
+}
@@ -0,0 +1,220 @@
+/* Temporally blocked (wavefront) version of the Jacobi solver.
+ *
+ * A plain Jacobi sweep streams both grids through memory once per iteration.
+ * Here every pass advances the grid several time steps (levels) while the
+ * rows involved are still in cache. Level s+1 of row i only needs rows
+ * i-1..i+1 of level s, so at step k we compute row k of level 1, row k-1 of
+ * level 2, ..., row k-T+1 of level T. The columns are cut into tiles that
+ * are skewed one column to the left per level, which turns every tile into
+ * a parallelepiped in (row, column, time). With that skew the two grids are
+ * enough: a point of level s+1 only overwrites level s-1 after every reader
+ * of it is done, so each point gets exactly the same arithmetic as in the
+ * double-buffer solver and the result matches bit-for-bit.
+ *
+ * Tiles are handed out round-robin to the threads. Tile c may run step k
+ * only once tile c-1 has finished step k, which makes the threads a pipeline
+ * moving from west to east.
+ *
+ * Compiled together with solver.c, see the compile line there.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <math.h>
+#include "grid.h"
+
+/* Structure that holds the arguments for the wavefront threads */
+typedef struct wave_args_s {
+    int tid;                /* Thread ID */
+    int num_threads;
+    int dim;
+    int num_tiles;
+    int tile_width;
+    int time_steps;         /* Levels advanced in this pass */
+    float *level_0;         /* Buffer holding even levels */
+    float *level_1;         /* Buffer holding odd levels */
+    int *progress;          /* Last step finished for every tile */
+    double *diff;           /* Sum of |new - old| for every level, private to the thread */
+} WAVE_ARGS_t;
+
+#define NEAR_MARGIN 1.05    /* Slack on eps when predicting convergence */
+
+void * wavefront_worker (void *);
+
+/*------------------------------------------------------------------
+ * Function:    compute_using_wavefront_jacobi
+ * Purpose:     Solve the grid with the Jacobi method, advancing time_steps
+ *              levels per pass over memory. grid_0 and grid_1 must hold the
+ *              same initial conditions. Convergence is tested for every
+ *              level, exactly as in compute_using_pthreads_jacobi. When the
+ *              diff trend predicts convergence within the next two passes the
+ *              engine drops to one level per pass so it stops on the same
+ *              iteration as the plain solver. If the prediction misses, the
+ *              overshoot is reported
+ *
+ * Input args:  grid_0, grid_1, num_threads, time_steps, tile_width (0 = whole rows)
+ * Output args: num_iter
+ * Return val:  grid holding the newest level
+ */  /*  */
+grid_t *
+compute_using_wavefront_jacobi (grid_t *grid_0, grid_t *grid_1, int num_threads, int time_steps,
+                                int tile_width, int *num_iter)
+{
+    int dim = grid_0->dim;
+    float eps = 1e-6;
+    int i, s;
+
+    if (num_threads < 1)
+        num_threads = 1;
+    if (time_steps < 1)
+        time_steps = 1;
+    if (tile_width <= 0 || tile_width > dim - 2)
+        tile_width = dim - 2;
+    int num_tiles = (dim - 2 + tile_width - 1) / tile_width;
+
+    pthread_t *worker_thread = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+    WAVE_ARGS_t *args_for_thread = (WAVE_ARGS_t *) malloc (num_threads * sizeof (WAVE_ARGS_t));
+    int *progress = (int *) malloc (num_tiles * sizeof (int));
+    double *diff = (double *) malloc (num_threads * time_steps * sizeof (double));
+    if (worker_thread == NULL || args_for_thread == NULL || progress == NULL || diff == NULL) {
+        perror ("malloc");
+        exit (EXIT_FAILURE);
+    }
+
+    grid_t *newest = grid_0;
+    grid_t *other = grid_1;
+    double num_elements = (double) (dim - 2) * (dim - 2);
+    double first_diff = 0.0, last_diff = 0.0;
+    int near = 0;
+    int done = 0;
+    *num_iter = 0;
+
+    while (!done) {
+        /* Near convergence fall back to one level per pass to avoid stepping past it.
+         * The diff is noisy at this precision, so use the mean rate over the last
+         * pass and allow a few percent of slack. */
+        int steps = time_steps;
+        if (!near && *num_iter > 0 && time_steps > 1) {
+            double rate = pow (last_diff/first_diff, 1.0/(time_steps - 1));
+            if (rate > 1.0)
+                rate = 1.0;
+            if (last_diff * pow (rate, 2 * time_steps) < NEAR_MARGIN * eps)
+                near = 1;
+        }
+        if (near)
+            steps = 1;
+
+        memset (progress, 0, num_tiles * sizeof (int));
+        for (i = 0; i < num_threads; i++) {
+            args_for_thread[i].tid = i;
+            args_for_thread[i].num_threads = num_threads;
+            args_for_thread[i].dim = dim;
+            args_for_thread[i].num_tiles = num_tiles;
+            args_for_thread[i].tile_width = tile_width;
+            args_for_thread[i].time_steps = steps;
+            args_for_thread[i].level_0 = newest->element;
+            args_for_thread[i].level_1 = other->element;
+            args_for_thread[i].progress = progress;
+            args_for_thread[i].diff = &diff[i * time_steps];
+
+            if ((create_solver_thread (&worker_thread[i], i, num_threads, wavefront_worker, (void *)&args_for_thread[i])) != 0) {
+                perror ("pthread_create");
+                exit (EXIT_FAILURE);
+            }
+        }
+        for (i = 0; i < num_threads; i++)
+            pthread_join (worker_thread[i], NULL);
+
+        /* Test every level of the pass for convergence, in order */
+        for (s = 0; s < steps && !done; s++) {
+            double test = 0.0;
+            for (i = 0; i < num_threads; i++)
+                test += diff[i * time_steps + s];
+            test = test/num_elements;
+
+            (*num_iter)++;
+            printf ("Iteration: %d - DIFF: %f\n", *num_iter, test);
+            if (s == 0)
+                first_diff = test;
+            last_diff = test;
+            if (test < eps) {
+                done = 1;
+                if (s < steps - 1)
+                    printf ("Converged inside a blocked pass, result is %d iterations past convergence\n", steps - 1 - s);
+            }
+        }
+
+        /* An odd number of levels leaves the newest one in the other buffer */
+        if (steps % 2 == 1) {
+            grid_t *tmp = newest;
+            newest = other;
+            other = tmp;
+        }
+    }
+
+    free ((void *) worker_thread);
+    free ((void *) args_for_thread);
+    free ((void *) progress);
+    free ((void *) diff);
+    return newest;
+}
+
+/*------------------------------------------------------------------
+ * Function:    wavefront_worker
+ * Purpose:     Run the tiles owned by this thread through every step of the
+ *              wavefront. At step k row k-s is advanced from level s to
+ *              level s+1, over the tile's columns shifted s to the left
+ *
+ * Input args:  this_arg (thread argument structure)
+ * Return val:  NULL
+ */  /*  */
+void *
+wavefront_worker (void *this_arg)
+{
+    WAVE_ARGS_t *args_for_me = (WAVE_ARGS_t *) this_arg;
+    int dim = args_for_me->dim;
+    int steps = args_for_me->time_steps;
+    int last_tile = args_for_me->num_tiles - 1;
+    int *progress = args_for_me->progress;
+    double *diff = args_for_me->diff;
+    int c, k, s, i;
+
+    for (s = 0; s < steps; s++)
+        diff[s] = 0.0;
+
+    for (c = args_for_me->tid; c <= last_tile; c += args_for_me->num_threads) {
+        int j_start = 1 + c * args_for_me->tile_width;
+        int j_end = (c == last_tile) ? dim - 1 : j_start + args_for_me->tile_width;
+
+        for (k = 1; k < dim + steps - 2; k++) {
+            /* The tile to the west must be done with this step */
+            if (c > 0)
+                while (__atomic_load_n (&progress[c - 1], __ATOMIC_ACQUIRE) < k)
+                    sched_yield ();
+
+            for (s = 0; s < steps; s++) {
+                i = k - s;
+                if (i < 1)
+                    break;
+                if (i > dim - 2)
+                    continue;
+
+                int js = j_start - s;
+                int je = (c == last_tile) ? dim - 1 : j_end - s;
+                if (js < 1)
+                    js = 1;
+                if (s % 2 == 0)
+                    diff[s] += jacobi_row (args_for_me->level_0, args_for_me->level_1, dim, i, js, je);
+                else
+                    diff[s] += jacobi_row (args_for_me->level_1, args_for_me->level_0, dim, i, js, je);
+            }
+            __atomic_store_n (&progress[c], k, __ATOMIC_RELEASE);
+        }
+    }
+    return NULL;
+}
@@ -6,4 +6,9 @@ typedef struct grid_s {
 	float *element;
 } grid_t;
 
+/* Row kernels, see ../../jacobi_project/kernels.c */
+extern double (*jacobi_row) (const float *, float *, int, int, int, int);
+extern const char *kernel_name;
+int select_kernel (const char *);
+
 #endif
\ No newline at end of file
@@ -4,7 +4,7 @@
  * Date modified: February 21, 2020
  *
  * Compile as follows:
- * gcc -o solver_simple solver_simple.c solver_gold.c -O3 -Wall -std=c99 -lm -lpthread 
+ * gcc -o solver_simple solver_simple.c solver_gold.c ../../jacobi_project/kernels.c -O3 -Wall -std=c99 -lm -lpthread 
  *
  * If you wish to see debug info, add the -D DEBUG option when compiling the code.
  */
@@ -28,7 +28,6 @@ void print_grid (grid_t *);
 void print_stats (grid_t *);
 double grid_mse (grid_t *, grid_t *);
 void *workerjob(void *);
-double update (grid_t *, grid_t *, int, int);
 
 /* Structure used to pass arguments to the worker threads */
 typedef struct args_t {
@@ -52,10 +51,11 @@ pthread_mutex_t mutex;              /* Lock for the shared variable diff */
 int main (int argc, char **argv)
 {
 	if (argc < 5) {
-        printf ("Usage: %s grid-dimension num-threads min-temp max-temp\n", argv[0]);
+        printf ("Usage: %s grid-dimension num-threads min-temp max-temp [kernel]\n", argv[0]);
         printf ("grid-dimension: The dimension of the grid\n");
         printf ("num-threads: Number of threads\n"); 
         printf ("min-temp, max-temp: Heat applied to the north side of the plate is uniformly distributed between min-temp and max-temp\n");
+        printf ("kernel: stencil kernel, auto (default), scalar, sse, avx2 or avx512\n");
         exit (EXIT_FAILURE);
     }
     
@@ -64,7 +64,13 @@ int main (int argc, char **argv)
     int num_threads = atoi (argv[2]);
     float min_temp = atof (argv[3]);
     float max_temp = atof (argv[4]);
+    char *kernel = (argc > 5) ? argv[5] : "auto";
 
+    if (select_kernel (kernel) != 0) {
+        printf ("Stencil kernel %s is unknown or not supported by this CPU\n", kernel);
+        exit (EXIT_FAILURE);
+    }
+    printf ("Using the %s stencil kernel\n", kernel_name);
     
     /* Generate the grids and populate them with initial conditions. */
  	grid_t *grid_1 = create_grid (dim, min_temp, max_temp);
@@ -192,7 +198,7 @@ void *workerjob(void *arg)
 {
     ARGS *args_for_me = (ARGS *) arg; /* Typecast argument passed to function to appropriate type */
     int dim = gridA->dim;
-    int i, j;
+    int i;
 
     double diff = 0.0;
     int num_ele = 0;
@@ -210,20 +216,16 @@ void *workerjob(void *arg)
     //For every other iteration, we want to swap the reading and writing grids.
     if (iteration % 2 == 1){  //odd iteration
         for (i = args_for_me->tid + 1; i < (gridA->dim - 1); i += args_for_me->num_threads) {
-            for (j = 1; j < (gridA->dim - 1); j++) {
-                diff +=update(gridA, gridB, i, j);
-                num_ele++;
-                //read from A, write to B
-            }
+            diff += jacobi_row (gridA->element, gridB->element, dim, i, 1, dim - 1);
+            num_ele += dim - 2;
+            //read from A, write to B
         }
     }
     else { //even iteration
         for (i = args_for_me->tid + 1; i < (gridB->dim - 1); i += args_for_me->num_threads) {
-            for (j = 1; j < (gridB->dim - 1); j++) {
-                diff += update (gridB, gridA, i, j);
-                num_ele++;
-                //read from B, write to A
-            }
+            diff += jacobi_row (gridB->element, gridA->element, dim, i, 1, dim - 1);
+            num_ele += dim - 2;
+            //read from B, write to A
         }
     }
 
@@ -236,26 +238,6 @@ void *workerjob(void *arg)
 
 }
 
-double update (grid_t *Rgrid, grid_t *Wgrid, int i, int j){
-    float old, new;
-    double diff;
-
-    old = Rgrid->element[i * Rgrid->dim + j]; /* Store old value of grid point. */
-    /* Apply the update rule. */	
-    new = 0.25 * (Rgrid->element[(i - 1) * Rgrid->dim + j] +\
-                  Rgrid->element[(i + 1) * Rgrid->dim + j] +\
-                  Rgrid->element[i * Rgrid->dim + (j + 1)] +\
-                  Rgrid->element[i * Rgrid->dim + (j - 1)]);
-
-    Wgrid->element[i * Wgrid->dim + j] = new; /* Update the grid-point value. */
-    return diff = fabs(new - old); /* Calculate the difference in values. */
-
-    // pthread_mutex_lock(&mutex);
-    // bigdiff = bigdiff + diff; /* Update the diff value. */
-    // pthread_mutex_unlock(&mutex);
-
-}
-
 /* Create a grid with the specified initial conditions. */
 grid_t *create_grid (int dim, float min, float max)
 {